@@ -0,0 +1,91 @@
+#include "affinity.h"
+#include <algorithm>
+
+size_t PairHash::operator()(const std::pair<long, long> &p) const {
+  // splitmix64 finaliser over both ids.
+  unsigned long long h = p.first * 0x9e3779b97f4a7c15ull ^ p.second;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+  return h ^ (h >> 31);
+}
+
+AffinityStore::AffinityStore() : shards(num_shards) {}
+
+std::pair<long, long> AffinityStore::key(long a, long b) {
+  return a < b ? std::make_pair(a, b) : std::make_pair(b, a);
+}
+
+// The shard holding the pair. Uses the high half of the hash, so that the
+// choice of shard is independent of the bucket within it.
+int AffinityStore::shard(long a, long b) {
+  return (PairHash()(key(a, b)) >> 32) % num_shards;
+}
+
+// Adds `increment` to the pair's affinity, clamped to [0, 1], and returns the
+// new value. Pairs whose affinity is zero are not kept.
+double AffinityStore::update(long a, long b, double d2, double increment,
+                             long epoch) {
+  Shard &pairs = shards[shard(a, b)];
+  auto iter = pairs.find(key(a, b));
+  double old_value = (iter == pairs.end()) ? 0.0 : iter->second.value;
+  double value = std::max(std::min(old_value + increment, 1.0), 0.0);
+
+  if (value <= 0.0) {
+    if (iter != pairs.end())
+      pairs.erase(iter);
+  } else if (iter == pairs.end()) {
+    pairs.emplace(key(a, b), Affinity{d2, value, epoch});
+  } else {
+    iter->second = {d2, value, epoch};
+  }
+
+  return value;
+}
+
+void AffinityStore::insert(long a, long b, const Affinity &affinity) {
+  shards[shard(a, b)][key(a, b)] = affinity;
+}
+
+// Pairs not updated this epoch are out of range; decay them and evict any
+// that return to zero.
+void AffinityStore::sweep(long epoch, double decay) {
+  for (int s = 0; s < num_shards; s++)
+    sweep(s, epoch, decay);
+}
+
+void AffinityStore::sweep(int s, long epoch, double decay) {
+  Shard &pairs = shards[s];
+  for (auto iter = pairs.begin(); iter != pairs.end();) {
+    Affinity &a = iter->second;
+    if (a.epoch != epoch) {
+      a.value -= decay;
+      a.epoch = epoch;
+    }
+    if (a.value <= 0.0)
+      iter = pairs.erase(iter);
+    else
+      ++iter;
+  }
+}
+
+void AffinityStore::clear() {
+  for (auto &pairs : shards)
+    pairs.clear();
+}
+
+int AffinityStore::size() const {
+  int n = 0;
+  for (auto &pairs : shards)
+    n += pairs.size();
+  return n;
+}
+
+const Affinity *AffinityStore::find(long a, long b) const {
+  const Shard &pairs = shards[shard(a, b)];
+  auto iter = pairs.find(key(a, b));
+  return (iter == pairs.end()) ? NULL : &iter->second;
+}
+
+const AffinityStore::Shard &AffinityStore::shard_value(int s) const {
+  return shards[s];
+}
@@ -0,0 +1,47 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct PairHash {
+  size_t operator()(const std::pair<long, long> &) const;
+};
+
+struct Affinity {
+  double d2, value;
+  long epoch;
+};
+
+// Pairwise distances and affinities, keyed by the ids of the two entities.
+// Only pairs that were within interaction range recently are held. Pairs are
+// split over a fixed number of shards by hash; different shards may be
+// updated or swept from different threads at once.
+class AffinityStore {
+
+public:
+  typedef std::unordered_map<std::pair<long, long>, Affinity, PairHash> Shard;
+
+private:
+  std::vector<Shard> shards;
+
+  static std::pair<long, long> key(long, long);
+
+public:
+  static constexpr int num_shards = 64;
+
+  AffinityStore();
+  static int shard(long, long);
+  double update(long, long, double, double, long);
+  void insert(long, long, const Affinity &);
+  void sweep(long, double);
+  void sweep(int, long, double);
+  void clear();
+  int size() const;
+  const Affinity *find(long, long) const;
+  const Shard &shard_value(int) const;
+};
+
+#endif
@@ -0,0 +1,489 @@
+// Microbenchmarks for the simulation hot paths. Every world is built from a
+// fixed seed so that runs are comparable across builds.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "affinity.h"
+#include "entity.h"
+#include "genealogy.h"
+#include "intercept.h"
+#include "state.h"
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr unsigned long seed = 12345;
+
+// World area per entity, in square units.
+constexpr double sparse_area = 10000.0;
+constexpr double dense_area = 400.0;
+
+struct Options {
+  long max_population = 100000;
+  double min_time = 0.5;
+  std::string filter;
+};
+
+Options options;
+
+State *make_state(int n, double area_per_entity) {
+  double y_size = std::sqrt(n * area_per_entity / 1.6);
+  double x_size = 1.6 * y_size;
+  State *state = new State(100.0, 0l, x_size, y_size, seed);
+  for (int i = 0; i < n; i++)
+    state->add_entity(std::to_string(i));
+  return state;
+}
+
+bool selected(const std::string &name) {
+  return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+// Repeats `setup` then `body` until the timed bodies add up to min_time.
+// `body` returns the number of operations and entity-ticks it performed.
+void run(const std::string &name, std::function<void()> setup,
+         std::function<void(long &, long &)> body) {
+  if (!selected(name))
+    return;
+
+  std::chrono::duration<double> elapsed(0.0);
+  long ops = 0, entity_ticks = 0;
+
+  do {
+    setup();
+    auto start = clock_type::now();
+    body(ops, entity_ticks);
+    elapsed += clock_type::now() - start;
+  } while (elapsed.count() < options.min_time);
+
+  std::printf("%-34s %14.1f ns/op", name.c_str(), 1e9 * elapsed.count() / ops);
+  if (entity_ticks > 0)
+    std::printf(" %14.0f entity-ticks/s", entity_ticks / elapsed.count());
+  std::printf("\n");
+  std::fflush(stdout);
+}
+
+// Each run starts from a fresh world so the population can't die out or
+// explode over a long measurement; ops are ticks.
+void bench_update(int n, const char *density, double area) {
+  State *state = NULL;
+  constexpr int ticks_per_run = 10;
+
+  run("update/" + std::string(density) + "/" + std::to_string(n),
+      [&] {
+        delete state;
+        state = make_state(n, area);
+      },
+      [&](long &ops, long &entity_ticks) {
+        for (int t = 0; t < ticks_per_run; t++) {
+          entity_ticks += state->num_entities();
+          state->update();
+        }
+        ops += ticks_per_run;
+      });
+  delete state;
+}
+
+void bench_nearest_target(int n, const std::string &looking_for) {
+  State *state = make_state(n, dense_area);
+  std::vector<Entity *> actors = state->entities_value();
+  actors.resize(std::min<size_t>(actors.size(), 1000));
+  double time_of_travel;
+  state->index_targets();
+
+  run("nearest_target/" + looking_for + "/" + std::to_string(n), [] {},
+      [&](long &ops, long &) {
+        for (auto &actor : actors)
+          state->nearest_target(actor, time_of_travel, looking_for);
+        ops += actors.size();
+      });
+
+  std::vector<const Entity *> found;
+  std::vector<double> times;
+  run("nearest_targets/" + looking_for + "/" + std::to_string(n), [] {},
+      [&](long &ops, long &) {
+        state->nearest_targets(actors, looking_for, found, times);
+        ops += actors.size();
+      });
+  delete state;
+}
+
+void bench_intercept_time(int n) {
+  State *state = make_state(n, dense_area);
+  const std::vector<Entity *> &entities = state->entities_value();
+  volatile double sink = 0.0;
+
+  run("entity_intercept_time/" + std::to_string(n), [] {},
+      [&](long &ops, long &) {
+        for (int i = 0; i < n; i++)
+          sink = sink + state->entity_intercept_time(entities[i],
+                                                     entities[(i + 1) % n]);
+        ops += n;
+      });
+  delete state;
+}
+
+// State::entity_intercept_time() as it was before intercept.h, with
+// minimum_vector() and smallest_non_negative_or_NaN() inlined, for checking
+// that the solver still gives the same times.
+double reference_intercept_time(const Pursuer &p, double Ptx, double Pty,
+                                double Vtx, double Vty) {
+  double a, b, c, t1, t2, dx, dy, Phx, Phy;
+  double sh = p.speed;
+
+  dx = p.x - Ptx;
+  dy = p.y - Pty;
+  if (std::abs(dx) > p.x_size - std::abs(dx))
+    dx = p.x_size - std::abs(dx);
+  if (std::abs(dy) > p.y_size - std::abs(dy))
+    dy = p.y_size - std::abs(dy);
+  Phx = dx + Ptx;
+  Phy = dy + Pty;
+
+  a = (Vtx * Vtx) + (Vty * Vty) - (sh * sh);
+  b = 2 * ((Ptx * Vtx) + (Pty * Vty) - (Phx * Vtx) - (Phy * Vty));
+  c = (Ptx * Ptx) + (Pty * Pty) + (Phx * Phx) + (Phy * Phy) - (2 * Phx * Ptx) -
+      (2 * Phy * Pty);
+
+  t1 = (-b + sqrt((b * b) - (4 * a * c))) / (2 * a);
+  t2 = (-b - sqrt((b * b) - (4 * a * c))) / (2 * a);
+
+  if (t1 <= 0.0 || std::isnan(t1)) {
+    if (t2 >= 0.0 && !std::isnan(t2))
+      return t2;
+    return 0.0;
+  }
+  return t1;
+}
+
+// Exits unless intercept_time(), intercept_times() and the reference agree
+// to the bit on every target; `expected`, if given, must agree too.
+void check_intercept_times(const std::string &what, const Pursuer &p, int n,
+                           const double *tx, const double *ty,
+                           const double *vx, const double *vy,
+                           const double *expected = NULL) {
+  std::vector<double> batched(n);
+  intercept_times(p, n, tx, ty, vx, vy, batched.data());
+  for (int k = 0; k < n; k++) {
+    double t = reference_intercept_time(p, tx[k], ty[k], vx[k], vy[k]);
+    double scalar = intercept_time(p, tx[k], ty[k], vx[k], vy[k]);
+    const char *wrong = NULL;
+    double got;
+    if (std::memcmp(&scalar, &t, sizeof(double)) != 0) {
+      wrong = "intercept_time";
+      got = scalar;
+    } else if (std::memcmp(&batched[k], &t, sizeof(double)) != 0) {
+      wrong = "intercept_times";
+      got = batched[k];
+    } else if (expected != NULL &&
+               std::memcmp(&expected[k], &t, sizeof(double)) != 0) {
+      wrong = "entity_intercept_time";
+      got = expected[k];
+    }
+    if (wrong != NULL) {
+      std::printf("%s: %s disagrees for target %d: %.17g, not %.17g\n",
+                  what.c_str(), wrong, k, got, t);
+      std::exit(1);
+    }
+  }
+}
+
+// Cases the bench worlds rarely or never produce: a pursuer that can't
+// move, one already where its target is, targets as fast as it (so the
+// quadratic is linear), targets it can never catch (no real root), and
+// targets across the world's edge.
+void check_intercept_edge_cases() {
+  const double x_size = 1000.0, y_size = 800.0, x = 100.0, y = 100.0;
+  std::vector<double> tx, ty, vx, vy;
+  for (double target_x : {x, x + 10.0, x - 95.0, x_size - 1.0})
+    for (double target_y : {y, y + 10.0, y_size - 5.0})
+      for (double v : {0.0, 1.0, 2.0})
+        for (auto direction : {std::make_pair(1.0, 0.0), {0.0, 1.0},
+                               {-1.0, 0.0}, {-0.6, 0.8}}) {
+          tx.push_back(target_x);
+          ty.push_back(target_y);
+          vx.push_back(v * direction.first);
+          vy.push_back(v * direction.second);
+        }
+  for (double speed : {0.0, 1.0, 2.0, 3.0}) {
+    Pursuer p = {x, y, speed, x_size, y_size};
+    check_intercept_times("edge cases at speed " + std::to_string(speed), p,
+                          tx.size(), tx.data(), ty.data(), vx.data(),
+                          vy.data());
+  }
+}
+
+// One pursuer against everyone, solved one at a time and then in batches.
+// Both must agree to the bit with the formula they replaced, and with
+// State::entity_intercept_time(), or the benchmark exits.
+void bench_intercept_times(int n) {
+  State *state = make_state(n, dense_area);
+  for (int t = 0; t < 10; t++)
+    state->update();
+  const Population &p = state->population_value();
+  int m = p.size();
+  if (m == 0) {
+    delete state;
+    return;
+  }
+  Pursuer pursuer = state->pursuer(state->entities_value()[0]);
+  std::vector<double> scalar(m), batched(m);
+  volatile double sink = 0.0;
+
+  run("intercept_time/scalar/" + std::to_string(n), [] {},
+      [&](long &ops, long &) {
+        for (int k = 0; k < m; k++)
+          scalar[k] = intercept_time(pursuer, p.x[k], p.y[k], p.px[k], p.py[k]);
+        sink = sink + scalar[m - 1];
+        ops += m;
+      });
+  run("intercept_times/batched/" + std::to_string(n), [] {},
+      [&](long &ops, long &) {
+        intercept_times(pursuer, m, p.x.data(), p.y.data(), p.px.data(),
+                        p.py.data(), batched.data());
+        sink = sink + batched[m - 1];
+        ops += m;
+      });
+
+  const std::vector<Entity *> &entities = state->entities_value();
+  std::vector<double> expected(m);
+  for (int k = 0; k < m; k++)
+    expected[k] = state->entity_intercept_time(entities[0], entities[k]);
+  check_intercept_times("intercept_times/" + std::to_string(n), pursuer, m,
+                        p.x.data(), p.y.data(), p.px.data(), p.py.data(),
+                        expected.data());
+  check_intercept_edge_cases();
+  delete state;
+}
+
+void bench_move(int n) {
+  State *state = make_state(n, dense_area);
+  state->index_targets();
+
+  Deferred deferred;
+
+  run("Entity::move/" + std::to_string(n), [] {},
+      [&](long &ops, long &) {
+        deferred.clear();
+        for (auto &e : state->entities_value())
+          e->move(deferred);
+        ops += n;
+      });
+  delete state;
+}
+
+void bench_mate(int n) {
+  State *state = NULL;
+  int pairs = std::min(n / 2, 1000);
+
+  run("Entity::mate/" + std::to_string(n),
+      [&] {
+        delete state;
+        state = make_state(n, dense_area);
+      },
+      [&](long &ops, long &) {
+        std::vector<Entity *> entities = state->entities_value();
+        for (int i = 0; i < pairs; i++)
+          entities[2 * i]->mate(*entities[2 * i + 1]);
+        ops += pairs;
+      });
+  delete state;
+}
+
+// Stands in for the old resize_pairwise(): the per-tick cost of maintaining
+// pairwise data is now updating and sweeping the sparse affinity store.
+void bench_affinities(int n) {
+  AffinityStore store;
+  long epoch = 0;
+  constexpr int pairs_per_entity = 4;
+
+  run("affinity_update_sweep/" + std::to_string(n), [] {},
+      [&](long &ops, long &) {
+        epoch++;
+        for (long a = 0; a < n; a++) {
+          for (long k = 1; k <= pairs_per_entity; k++)
+            store.update(a, (a + k * epoch) % n, 1.0, 0.5, epoch);
+        }
+        store.sweep(epoch, 2.5);
+        ops += n * pairs_per_entity;
+      });
+}
+
+void bench_remove_corpses(int n) {
+  State *state = NULL;
+  int corpses = std::max(n / 10, 1);
+
+  run("remove_corpses/" + std::to_string(n),
+      [&] {
+        delete state;
+        state = make_state(n, dense_area);
+        std::vector<Entity *> entities = state->entities_value();
+        for (int i = 0; i < corpses; i++)
+          entities[(i * 7919) % n]->kill();
+      },
+      [&](long &ops, long &) {
+        state->remove_corpses(-1.0);
+        ops += corpses;
+      });
+  delete state;
+}
+
+// Births and deaths in equal numbers, so that after the first round every
+// new entity reuses the slot of one just erased.
+void bench_churn(int n) {
+  State *state = make_state(n, dense_area);
+  int turnover = std::max(n / 10, 1);
+  long round = 0;
+
+  run("entity_churn/" + std::to_string(n), [] {},
+      [&](long &ops, long &) {
+        std::vector<Entity *> entities = state->entities_value();
+        for (int i = 0; i < turnover; i++)
+          entities[(i * 7919) % n]->kill();
+        state->remove_corpses(-1.0);
+        for (int i = 0; i < turnover; i++)
+          state->add_entity("c" + std::to_string(round++));
+        ops += turnover;
+      });
+  delete state;
+}
+
+// A genealogy of n founders and 9n descendants, each born to two parents
+// from the generations just before it, with the earliest half dead.
+void make_genealogy(Genealogy &genealogy, int n) {
+  std::mt19937 rng(seed);
+  genealogy.clear();
+  for (int i = 0; i < n; i++)
+    genealogy.add(i, 0, 0);
+  for (int i = n; i < 10 * n; i++) {
+    std::uniform_int_distribution<int> earlier(i - n, i - 1);
+    genealogy.add(i, i, 0, earlier(rng), earlier(rng));
+  }
+  for (int i = 0; i < 5 * n; i++)
+    genealogy.set_death(i, i);
+}
+
+void bench_genealogy(int n) {
+  Genealogy genealogy;
+  volatile long sink = 0;
+
+  run("genealogy_add/" + std::to_string(n), [] {},
+      [&](long &ops, long &) {
+        make_genealogy(genealogy, n);
+        ops += 10 * n;
+      });
+
+  int queries = std::min(n, 1000);
+  run("genealogy_common_ancestor/" + std::to_string(n), [] {},
+      [&](long &ops, long &) {
+        for (int k = 0; k < queries; k++)
+          sink = sink + genealogy.common_ancestor(10 * n - 1 - k,
+                                                  10 * n - 1 - (k * 7) % n);
+        ops += queries;
+      });
+
+  run("genealogy_surviving_lineages/" + std::to_string(n), [] {},
+      [&](long &ops, long &) {
+        sink = sink + genealogy.num_surviving_lineages();
+        ops += 1;
+      });
+}
+
+// An entity eaten earlier in a tick's commit is only marked to die, and
+// can still eat later in it: here B eats A, and then A, which natural
+// defenses keep stronger than C, eats C. Exits unless both meals happen.
+void check_eaten_entities_still_eat() {
+  State state(100.0, 0l, 100.0, 100.0, seed);
+  Population &p = *state.get_population();
+  const Genome a = trait_bit(Trait::stationary) |
+                   trait_bit(Trait::intelligent) |
+                   trait_bit(Trait::natural_defenses);
+  // B has every trait, so differs from A in all of its other bits and will
+  // eat it; C has no defenses, and differs from A in enough bits for A to
+  // eat it. All three stay put.
+  const Genome b = (Genome(1) << num_traits) - 1;
+  const Genome c = trait_bit(Trait::stationary) | trait_bit(Trait::asexual) |
+                   trait_bit(Trait::eats_intelligent) |
+                   trait_bit(Trait::eats_passive) |
+                   trait_bit(Trait::photosynthesizes);
+  const Genome genomes[3] = {a, b, c};
+  // A is big enough to be worth eating to a hungry B.
+  const double masses[3] = {50.0, 1.0, 1.0}, fed[3] = {0.9, 0.1, 0.5};
+
+  // Side by side, the three have full affinity after one tick.
+  for (int i = 0; i < 3; i++) {
+    state.add_entity(std::to_string(i), 50.0, 50.0, masses[i]);
+    p.genome[i] = genomes[i];
+    p.derive(i);
+    p.energy[i] = fed[i] * p.max_energy(i);
+  }
+  state.update();
+
+  if (state.event_count(Event::ate) != 2) {
+    std::printf("an eaten entity didn't go on to eat: %ld meals, not 2\n",
+                state.event_count(Event::ate));
+    std::exit(1);
+  }
+}
+
+void usage(const char *name) {
+  std::cerr << "Usage: " << name << " [options]\n"
+            << "  --max-population N  largest population to run (default "
+               "100000)\n"
+            << "  --min-time S        time each benchmark for at least S "
+               "seconds (default 0.5)\n"
+            << "  --filter TEXT       only run benchmarks whose name contains "
+               "TEXT\n";
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (arg == "--max-population") {
+      options.max_population = std::atol(value);
+    } else if (arg == "--min-time") {
+      options.min_time = std::atof(value);
+    } else if (arg == "--filter") {
+      options.filter = value;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  check_eaten_entities_still_eat();
+
+  for (int n : {100, 1000, 10000, 100000}) {
+    if (n > options.max_population)
+      break;
+
+    bench_update(n, "sparse", sparse_area);
+    bench_update(n, "dense", dense_area);
+    bench_nearest_target(n, "food");
+    bench_nearest_target(n, "mate");
+    bench_intercept_time(n);
+    bench_intercept_times(n);
+    bench_move(n);
+    bench_mate(n);
+    bench_affinities(n);
+    bench_remove_corpses(n);
+    bench_churn(n);
+    bench_genealogy(n);
+  }
+
+  return 0;
+}
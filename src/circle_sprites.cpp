@@ -0,0 +1,63 @@
+#include "circle_sprites.h"
+#include <algorithm>
+
+// Packs the sprites in rows, smallest first, leaving a pixel between them
+// so that filtering never bleeds one into the next.
+CircleSprites::CircleSprites() : height(0) {
+  discs.resize(max_radius + 1);
+  rings.resize(max_radius + 1);
+
+  int x = 0, y = 0, row_height = 0;
+  for (int r = 0; r <= max_radius; r++) {
+    for (Sprite *sprite : {&discs[r], &rings[r]}) {
+      int size = 2 * r + 1;
+      if (x + size > width) {
+        x = 0;
+        y += row_height + 1;
+        row_height = 0;
+      }
+      *sprite = {x, y, size};
+      x += size + 1;
+      row_height = std::max(row_height, size);
+    }
+  }
+  height = y + row_height;
+  coverage.assign(size_t(width) * height, 0);
+
+  for (int r = 0; r <= max_radius; r++) {
+    rasterise(discs[r], r, true);
+    rasterise(rings[r], r, false);
+  }
+}
+
+// A pixel is in the disc of radius r if its centre is within r + 1/2 of
+// the middle one, and on the ring if it's in the disc but not in the disc
+// of radius r - 1.
+void CircleSprites::rasterise(Sprite &sprite, int r, bool filled) {
+  auto inside = [](int dx, int dy, int radius) {
+    return radius >= 0 && dx * dx + dy * dy <= radius * radius + radius;
+  };
+  for (int dy = -r; dy <= r; dy++) {
+    for (int dx = -r; dx <= r; dx++) {
+      if (inside(dx, dy, r) && (filled || !inside(dx, dy, r - 1)))
+        coverage[size_t(sprite.y + dy + r) * width + sprite.x + dx + r] = 255;
+    }
+  }
+}
+
+// Radii beyond max_radius get the largest sprite, to be drawn scaled up.
+const CircleSprites::Sprite &CircleSprites::disc(int r) const {
+  return discs[std::min(std::max(r, 0), max_radius)];
+}
+
+const CircleSprites::Sprite &CircleSprites::ring(int r) const {
+  return rings[std::min(std::max(r, 0), max_radius)];
+}
+
+int CircleSprites::width_value() const { return width; }
+
+int CircleSprites::height_value() const { return height; }
+
+const std::vector<uint8_t> &CircleSprites::coverage_value() const {
+  return coverage;
+}
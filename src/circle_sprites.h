@@ -0,0 +1,39 @@
+#ifndef CIRCLE_SPRITES_H
+#define CIRCLE_SPRITES_H
+
+#include <cstdint>
+#include <vector>
+
+// Filled discs and one-pixel rings of every radius up to max_radius,
+// rasterised once into a single coverage map (255 inside, 0 outside) so
+// that circles are drawn by copying rather than by tessellating each one.
+// A sprite of radius r is 2r + 1 pixels square, centred on its middle
+// pixel.
+class CircleSprites {
+
+public:
+  static constexpr int max_radius = 48;
+
+  struct Sprite {
+    int x, y, size;
+  };
+
+private:
+  static constexpr int width = 1024;
+
+  int height;
+  std::vector<uint8_t> coverage;
+  std::vector<Sprite> discs, rings;
+
+  void rasterise(Sprite &, int, bool);
+
+public:
+  CircleSprites();
+  const Sprite &disc(int) const;
+  const Sprite &ring(int) const;
+  int width_value() const;
+  int height_value() const;
+  const std::vector<uint8_t> &coverage_value() const;
+};
+
+#endif
@@ -0,0 +1,56 @@
+// Prints a binary event log written by EventLog as the human-readable lines
+// the simulation used to print, optionally prefixed by the year.
+
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "event_log.h"
+
+int main(int argc, char **argv) {
+  bool years = false, ok = true;
+  const char *path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--years") == 0)
+      years = true;
+    else if (path == NULL)
+      path = argv[i];
+    else
+      ok = false;
+  }
+
+  if (path == NULL || !ok) {
+    std::cerr << "Usage: " << argv[0] << " [--years] LOG\n"
+              << "  --years  prefix each line with the year it happened\n";
+    return 1;
+  }
+
+  FILE *file = std::fopen(path, "rb");
+  if (file == NULL) {
+    std::cerr << "Can't open " << path << "." << std::endl;
+    return 1;
+  }
+  if (!EventLog::read_header(file)) {
+    std::cerr << path << " is not an event log of version "
+              << EventLog::version << "." << std::endl;
+    std::fclose(file);
+    return 1;
+  }
+
+  EventRecord records[1024];
+  size_t n;
+  std::cout << std::setprecision(3) << std::fixed;
+  while ((n = std::fread(records, sizeof(EventRecord), 1024, file)) > 0) {
+    for (size_t k = 0; k < n; k++) {
+      if (years)
+        std::cout << records[k].epoch / 86400.0 / 365.0 << ": ";
+      std::cout << EventLog::format_line(records[k]) << '\n';
+    }
+  }
+
+  std::fclose(file);
+  return 0;
+}
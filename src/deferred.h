@@ -0,0 +1,46 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <utility>
+#include <vector>
+
+class Entity;
+
+// Effects of a parallel per-entity phase that reach beyond the entity's own
+// population row, or that other entities read during the phase. Each chunk
+// of the phase records into its own buffer, and State applies the buffers
+// serially in chunk order, so results don't depend on the thread count.
+struct Deferred {
+  enum Cause { STARVED, NATURAL_CAUSES };
+
+  // A neighbouring pair proposed for interaction, i < j.
+  struct Contact {
+    int i, j, shard;
+    double d2, affinity;
+  };
+
+  struct Motion {
+    int index;
+    double px, py, energy;
+  };
+
+  std::vector<Motion> motions;
+  std::vector<int> births;
+  std::vector<std::pair<int, double>> energy;
+  std::vector<int> cell_moves;
+  std::vector<std::pair<int, Cause>> deaths;
+  std::vector<Contact> contacts;
+  std::vector<std::pair<int, const Entity *>> targets;
+
+  void clear() {
+    motions.clear();
+    births.clear();
+    energy.clear();
+    cell_moves.clear();
+    deaths.clear();
+    contacts.clear();
+    targets.clear();
+  }
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "density_grid.h"
+#include <algorithm>
+#include <cmath>
+
+DensityGrid::DensityGrid()
+    : columns(0), rows(0), x0(0.0), y0(0.0), cell_size(1.0) {}
+
+// Empties the grid and lays it out as `c` by `r` cells of `size` with its
+// top left corner at (x, y).
+void DensityGrid::reset(int c, int r, double x, double y, double size) {
+  columns = std::max(c, 0);
+  rows = std::max(r, 0);
+  x0 = x;
+  y0 = y;
+  cell_size = size;
+  cells.assign(4 * size_t(columns) * rows, 0);
+}
+
+// Counts an entity at (x, y), unless it's off the grid.
+void DensityGrid::add(double x, double y, const uint8_t rgba[4]) {
+  double column = std::floor((x - x0) / cell_size);
+  double row = std::floor((y - y0) / cell_size);
+  if (column < 0 || column >= columns || row < 0 || row >= rows)
+    return;
+  uint32_t *cell = &cells[4 * (size_t(row) * columns + size_t(column))];
+  cell[0]++;
+  cell[1] += rgba[0];
+  cell[2] += rgba[1];
+  cell[3] += rgba[2];
+}
+
+// Roughly how many entities are in a rectangle of the world: all of those
+// in the cells it touches.
+long DensityGrid::count(double left, double top, double right,
+                        double bottom) const {
+  int c0 = std::max(0.0, std::floor((left - x0) / cell_size));
+  int r0 = std::max(0.0, std::floor((top - y0) / cell_size));
+  int c1 = std::min(double(columns), std::ceil((right - x0) / cell_size));
+  int r1 = std::min(double(rows), std::ceil((bottom - y0) / cell_size));
+
+  long n = 0;
+  for (int r = r0; r < r1; r++)
+    for (int c = c0; c < c1; c++)
+      n += cells[4 * (size_t(r) * columns + c)];
+  return n;
+}
+
+// RGBA pixels, a cell each: the mean colour of the entities in it, clear
+// where there are none.
+void DensityGrid::average(std::vector<uint8_t> &pixels) const {
+  size_t n = size_t(columns) * rows;
+  pixels.resize(4 * n);
+  for (size_t k = 0; k < n; k++) {
+    const uint32_t *cell = &cells[4 * k];
+    uint8_t *pixel = &pixels[4 * k];
+    if (cell[0] == 0) {
+      std::fill(pixel, pixel + 4, 0);
+      continue;
+    }
+    for (int c = 0; c < 3; c++)
+      pixel[c] = cell[c + 1] / cell[0];
+    pixel[3] = 255;
+  }
+}
+
+// Like average(), but with the mean colour brightened to full and made more
+// opaque the more crowded the cell is, on a log scale up to the most crowded
+// cell.
+void DensityGrid::heat(std::vector<uint8_t> &pixels) const {
+  size_t n = size_t(columns) * rows;
+  uint32_t most = 1;
+  for (size_t k = 0; k < n; k++)
+    most = std::max(most, cells[4 * k]);
+  double scale = 1.0 / std::log1p(double(most));
+
+  pixels.resize(4 * n);
+  for (size_t k = 0; k < n; k++) {
+    const uint32_t *cell = &cells[4 * k];
+    uint8_t *pixel = &pixels[4 * k];
+    uint32_t brightest = std::max({cell[1], cell[2], cell[3], 1u});
+    for (int c = 0; c < 3; c++)
+      pixel[c] = 255ul * cell[c + 1] / brightest;
+    pixel[3] = cell[0] ? 64 + 191 * std::log1p(double(cell[0])) * scale : 0;
+  }
+}
+
+int DensityGrid::columns_value() const { return columns; }
+
+int DensityGrid::rows_value() const { return rows; }
+
+double DensityGrid::x0_value() const { return x0; }
+
+double DensityGrid::y0_value() const { return y0; }
+
+double DensityGrid::cell_size_value() const { return cell_size; }
@@ -0,0 +1,32 @@
+#ifndef DENSITY_GRID_H
+#define DENSITY_GRID_H
+
+#include <cstdint>
+#include <vector>
+
+// How many entities there are, and the sum of their colours, in each square
+// cell of a grid laid over a rectangle of the world. Draws crowds too big
+// to draw one by one: a cell per pixel gives points, coarser cells a
+// heatmap.
+class DensityGrid {
+
+private:
+  int columns, rows;
+  double x0, y0, cell_size;
+  std::vector<uint32_t> cells; // count, red, green, blue
+
+public:
+  DensityGrid();
+  void reset(int, int, double, double, double);
+  void add(double, double, const uint8_t[4]);
+  long count(double, double, double, double) const;
+  void average(std::vector<uint8_t> &) const;
+  void heat(std::vector<uint8_t> &) const;
+  int columns_value() const;
+  int rows_value() const;
+  double x0_value() const;
+  double y0_value() const;
+  double cell_size_value() const;
+};
+
+#endif
@@ -1,88 +1,164 @@
+#include "deferred.h"
 #include "entity.h"
+#include "entity_pool.h"
+#include "grid.h"
 #include "state.h"
 #include "utility.h"
+#include <bitset>
+#include <cassert>
 #include <cstdlib>
+#include <iostream>
 #include <random>
 #include <sstream>
 
-std::vector<std::string> Entity::all_traits = {
-    "stationary/mobile",        "asexual/sexual",
-    "intelligent/passive",      "eats intelligent/not",
-    "eats passive/not",         "photosynthesizes/not",
-    "geodispersal embryos/not", "geodispersal gametophytes/not",
-    "natural defenses/not",     "gestates/not"};
+std::vector<std::string> Entity::all_traits(std::begin(trait_names),
+                                           std::end(trait_names));
 
+// Stands in for hashing the name "(a + b)" of an offspring of parents named
+// a and b, without building it.
+static size_t lineage_hash(size_t a, size_t b) {
+  unsigned long long h = a * 0x9e3779b97f4a7c15ull ^ b;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+  return h ^ (h >> 31);
+}
+
+// Offspring pass the two entities that conceived them; their name is then
+// derived from the parents' and `name` is ignored.
 Entity::Entity(State *parent, const std::string &name, double x, double y,
-               double conception_mass, std::vector<unsigned short> igenome,
-               Entity *host)
-    : parent(parent), name(name), alive(true), will_die(false), host(host),
-      x(x), y(y), px(0), py(0), mood(0), age(0l),
-      conception_mass(conception_mass), current_target(NULL), genome(igenome) {
-  random_generator = parent->get_random_generator();
-  parasites = std::vector<Entity *>();
+               double conception_mass, const Genome *igenome, Entity *host,
+               const Entity *first_parent, const Entity *second_parent)
+    : parent(parent), population(parent->get_population()),
+      id(parent->new_entity_id()), parent_ids{-1, -1} {
+  if (first_parent != NULL && second_parent != NULL) {
+    parent_ids[0] = first_parent->id;
+    parent_ids[1] = second_parent->id;
+    name_hash_code =
+        lineage_hash(first_parent->name_hash_code, second_parent->name_hash_code);
+  } else {
+    this->name = name;
+    name_hash_code = std::hash<std::string>{}(name);
+  }
+
+  handle = parent->register_entity(this);
+  assign_host(host);
 
   assert(x != 0.0 && y != 0.0);
 
+  population->x[index] = x;
+  population->y[index] = y;
+  population->conception_mass[index] = conception_mass;
+  population->flags[index] |= Population::ALIVE;
+
   d = std::normal_distribution<double>(0.0, 1.0);
-  gene = std::uniform_int_distribution<int>(0, 1);
+  allele = std::uniform_int_distribution<int>(0, 1);
   u = std::uniform_real_distribution<double>(0.0, 1.0);
+  parent->get_entity_pool()->reuse(parasites);
+  parent->get_entity_pool()->reuse(pursuers);
 
-  if (genome.size() == 0) {
-    genome = std::vector<unsigned short>(all_traits.size());
+  RandomStream rng = random_stream(Site::birth);
 
-    for (auto &g: genome) {
-      g = gene(*random_generator);
+  if (igenome == NULL) {
+    Genome genome = 0;
+    for (int t = 0; t < num_traits; t++) {
+      genome |= Genome(allele(rng)) << t;
     }
+    population->genome[index] = genome;
+  } else {
+    population->genome[index] = *igenome;
   }
+  population->derive(index);
+
+  adjust_energy(max_energy() * (0.2 + 0.8 * u(rng)));
+
+  population->age[index] = birth_age();
+  population->derive(index);
+
+  parent->get_genealogy()->add(id, parent->epoch_value(), genome_value(),
+                               parent_ids[0], parent_ids[1]);
+}
+
+// Binds a restored entity to its existing population row; the caller
+// registers it and restores its links.
+Entity::Entity(State *parent, long id, const long parent_ids[2],
+               const std::string &name, size_t name_hash_code, int index)
+    : parent(parent), population(parent->get_population()), id(id),
+      parent_ids{parent_ids[0], parent_ids[1]}, name(name),
+      name_hash_code(name_hash_code), index(index) {
+  d = std::normal_distribution<double>(0.0, 1.0);
+  allele = std::uniform_int_distribution<int>(0, 1);
+  u = std::uniform_real_distribution<double>(0.0, 1.0);
+  parent->get_entity_pool()->reuse(parasites);
+  parent->get_entity_pool()->reuse(pursuers);
+}
 
-  adjust_energy(max_energy() * (0.2 + 0.8 * u(*random_generator)));
+Entity::~Entity() {}
 
-  age = birth_age();
+void *Entity::operator new(size_t size, EntityPool &pool) {
+  assert(size == sizeof(Entity));
+  return pool.allocate();
 }
 
-Entity::~Entity() {
-  parent->clear_target_from_entities(this);
+// Only called if a constructor throws.
+void Entity::operator delete(void *memory, EntityPool &pool) {
+  pool.deallocate(memory);
 }
 
-bool Entity::alive_value() const { return alive; }
+long Entity::id_value() const { return id; }
+
+// Ids of the two entities that mated to conceive this one, the initiator
+// first, or -1 for entities that were spawned.
+long Entity::parent_id_value(int k) const { return parent_ids[k]; }
+
+bool Entity::alive_value() const {
+  return population->flags[index] & Population::ALIVE;
+}
+
+bool Entity::will_die_value() const {
+  return population->flags[index] & Population::WILL_DIE;
+}
 
-bool Entity::will_die_value() const { return will_die; }
+Entity *Entity::host_value() const { return parent->entity_value(host); }
 
-Entity *Entity::host_value() const { return host; }
+Handle Entity::handle_value() const { return handle; }
 
-double Entity::x_value() const { return x; }
+int Entity::index_value() const { return index; }
 
-double Entity::y_value() const { return y; }
+int Entity::cell_value() const { return population->cell[index]; }
 
-double Entity::px_value() const { return px; }
+double Entity::x_value() const { return population->x[index]; }
 
-double Entity::py_value() const { return py; }
+double Entity::y_value() const { return population->y[index]; }
 
-double Entity::mood_value() const { return mood; }
+double Entity::px_value() const { return population->px[index]; }
 
-double Entity::age_value() const { return age; }
+double Entity::py_value() const { return population->py[index]; }
 
-double Entity::energy_value() const { return energy; }
+double Entity::mood_value() const { return population->mood[index]; }
+
+double Entity::age_value() const { return population->age[index]; }
+
+double Entity::energy_value() const { return population->energy[index]; }
 
 double Entity::max_speed_value() const { return max_speed; }
 
-long Entity::epoch_of_death_value() const { return epoch_of_death; }
+long Entity::epoch_of_death_value() const {
+  return population->epoch_of_death[index];
+}
 
 long Entity::time_since_death() const {
-  return parent->epoch_value() - epoch_of_death;
+  return parent->epoch_value() - population->epoch_of_death[index];
 }
 
 double Entity::kill_energy() const {
   return kill_energy_coefficient * current_mass();
 }
 
-double Entity::max_energy() const {
-  return conception_mass +
-         current_mass() * max_energy_coefficient * age / year;
-}
+double Entity::max_energy() const { return population->max_energy(index); }
 
 double Entity::prob_wants_food() const {
-  return std::max(0.0, 1.0 - energy / (hunger_threshold * max_energy()));
+  return std::max(0.0, 1.0 - energy_value() /
+                                 (hunger_threshold * max_energy()));
 }
 
 double Entity::prob_wants_mate() const {
@@ -93,34 +169,32 @@ double Entity::prob_wants_mate() const {
   double mate = mate_energy();
   if (maxe < mate)
     return 0.0;
-  return std::max(0.0, (energy - mate) / (maxe - mate));
+  return std::max(0.0, (energy_value() - mate) / (maxe - mate));
 }
 
 double Entity::prob_mutation() const {
-  return std::min(1.0, age / impotence_age());
+  return std::min(1.0, age_value() / impotence_age());
 }
 
-double Entity::prob_death() const {
-  return std::min(1.0, death_probability_coefficient * age / impotence_age());
-}
+double Entity::prob_death() const { return population->prob_death(index); }
 
 double Entity::current_strength() const {
-  return (gene_value("natural defenses/not") ? max_energy() : 0.0) +
-         (gene_value("stationary/mobile") ? 0.0 : age / year * energy);
+  return (gene<Trait::natural_defenses>() ? max_energy() : 0.0) +
+         (gene<Trait::stationary>() ? 0.0
+                                          : age_value() / year * energy_value());
 }
 
 double Entity::current_mass() const {
-  return conception_mass + std::log(1.0 + age / year);
+  return population->current_mass(index);
 }
 
 double Entity::terminal_speed() const {
-  // Assumes creatures are all same density.
-  return terminal_speed_coefficient * pow(current_mass(), 1.0 / 6.0);
+  return population->terminal_speed(index);
 }
 
 double Entity::mate_energy() const {
   return mate_energy_coefficient * max_energy() *
-         (gene_value("geodispersal gametophytes/not") ? 0.1 : 1.0);
+         (gene<Trait::geodispersal_gametophytes>() ? 0.1 : 1.0);
 }
 
 double Entity::conception_energy() const { return 2.0 * mate_energy(); }
@@ -129,49 +203,81 @@ double Entity::eating_energy() const {
   return eating_energy_coefficient * max_energy();
 }
 
-long Entity::impotence_age() const {
-  return impotence_age_coefficient *
-         (gene_value("stationary/mobile") ? 10 : 1);
-}
+long Entity::impotence_age() const { return population->impotence_age(index); }
 
-long Entity::birth_age() const {
-  return gene_value("gestates/not") ? birth_age_coefficient * impotence_age()
-                                    : 0;
-}
+long Entity::birth_age() const { return population->birth_age(index); }
 
-long Entity::age_since_birth() const { return age - birth_age(); }
+long Entity::age_since_birth() const { return age_value() - birth_age(); }
 
-std::string Entity::name_value() const { return name; }
+// Spawned entities keep the name they were given; offspring are named after
+// their parents' ids on demand.
+std::string Entity::name_value() const {
+  if (parent_ids[0] < 0)
+    return name;
+  return "(#" + std::to_string(parent_ids[0]) + " + #" +
+         std::to_string(parent_ids[1]) + ")";
+}
 
 std::string Entity::name_hash() const {
-  long hash = std::hash<std::string>{}(name);
+  long hash = name_hash_value();
   std::stringstream stream;
   stream << std::hex << hash;
   return stream.str();
 }
 
-const std::vector<unsigned short> *Entity::genome_value() const {
-  return &genome;
-}
+size_t Entity::name_hash_value() const { return name_hash_code; }
+
+Genome Entity::genome_value() const { return population->genome[index]; }
 
 const State *Entity::parent_value() const { return parent; }
 
-const Entity *Entity::current_target_value() const { return current_target; }
+const Entity *Entity::current_target_value() const {
+  return parent->entity_value(current_target);
+}
+
+// The stream for this entity's draws at `site` in the current tick. The
+// normal distribution caches a second value between calls, so reset it to
+// keep streams independent.
+RandomStream Entity::random_stream(Site site, long other) const {
+  d.reset();
+  return parent->random_stream(id, site, other);
+}
+
+// Changes the target, keeping the old and new targets' pursuers in step.
+void Entity::set_current_target(const Entity *target) {
+  Entity *old = parent->entity_value(current_target);
+  if (old == target)
+    return;
+  if (old != NULL)
+    remove_item_from_vector(old->pursuers, handle);
+  current_target = target ? target->handle : Handle();
+  if (target != NULL)
+    parent->entity_value(current_target)->pursuers.push_back(handle);
+}
+
+// Makes everyone chasing this entity stop, before it is erased.
+void Entity::drop_pursuers() {
+  for (auto &pursuer : pursuers)
+    parent->entity_value(pursuer)->current_target = Handle();
+  pursuers.clear();
+}
 
 bool Entity::will_mate() const {
-  return mood > mate_mood && energy >= mate_energy() &&
+  double age = age_value();
+  return mood_value() > mate_mood && energy_value() >= mate_energy() &&
          age - birth_age() > mating_age &&
          age - birth_age() < impotence_age() && parasite_count() == 0;
 }
 
 bool Entity::is_hungry() const {
-  if (1 - gene_value("intelligent/passive"))
+  if (1 - gene<Trait::intelligent>())
     return false;
-  return (energy < hunger_threshold * max_energy());
+  return (energy_value() < hunger_threshold * max_energy());
 }
 
 void Entity::adjust_mood(double adjustment) {
-  if (1 - gene_value("intelligent/passive")) {
+  double &mood = population->mood[index];
+  if (1 - gene<Trait::intelligent>()) {
     mood = 0.0;
   } else {
     mood = std::min(max_mood, std::max(min_mood, mood + adjustment));
@@ -179,103 +285,77 @@ void Entity::adjust_mood(double adjustment) {
 }
 
 void Entity::adjust_energy(double adjustment) {
-  double maxe = max_energy();
-  energy = std::min(maxe, std::max(0.0, energy + adjustment));
+  population->adjust_energy(index, adjustment);
 }
 
-void Entity::adjust_needs() {
-  age += parent->tick_time;
-  mood *= 0.998;
+// Steers the entity. Anything other entities may read while they steer too
+// (momentum, energy, host links, the grid) is recorded in `deferred` for
+// State to apply afterwards; positions are then advanced for the whole
+// population by State::move_entities().
+void Entity::move(Deferred &deferred) {
+  Population &p = *population;
+  const int i = index;
 
-  double cm = current_mass();
-  double metabolism =
-      (host == NULL)
-          ? cm * (-0.0005 - 0.0005 * gene_value("natural defenses/not"))
-          : 0;
-  double de = metabolism;
-
-  de += cm * (std::min(mood * 0.01, 0.0) +
-              0.0012 * gene_value("photosynthesizes/not"));
-
-  if (host != NULL)
-    host->adjust_energy(metabolism);
-
-  adjust_energy(de);
-}
-
-void Entity::check_for_death() {
-  if (alive) {
-    if (energy <= 0.0) {
-      kill();
-      std::cout << "Entity " << name_hash() << " starved to death."
-                << std::endl;
-    } else if (u(*random_generator) < prob_death()) {
-      kill();
-      std::cout << "Entity " << name_hash() << " died of natural causes."
-                << std::endl;
-    }
-  }
-}
-
-void Entity::move() {
-  if (!alive)
+  if (!alive_value())
     return;
 
-  if (gene_value("stationary/mobile"))
+  if (gene<Trait::stationary>())
     return;
 
-  if (host != NULL) {
-    if (age > birth_age()) {
-      // Detach from host.
-      remove_item_from_vector(host->parasites, this);
-      host = NULL;
-      std::cout << name << " was born!" << std::endl;
+  if (host_value() != NULL) {
+    if (p.age[i] > birth_age()) {
+      deferred.births.push_back(i);
     } else {
       return;
     }
   }
 
+  RandomStream rng = random_stream(Site::move);
+
   double ts = terminal_speed();
+  double px = p.px[i], py = p.py[i];
   double a = std::min(px * px + py * py, ts * ts) / (ts * ts);
   double drag = 1.0 - a;
-  double dpx = 0.0, dpy = 0.0, time_of_travel = 0.0;
+  double dpx = 0.0, dpy = 0.0, de = 0.0, time_of_travel = 0.0;
   double norm, dist;
 
-  std::tuple<double, double> dp;
-
   px *= drag;
   py *= drag;
 
-  if (energy >= 0.0) {
-    int intelligent = gene_value("intelligent/passive");
+  if (p.energy[i] >= 0.0) {
+    int intelligent = gene<Trait::intelligent>();
+    const Entity *target = current_target_value();
     if (intelligent) {
-      if (current_target != NULL) {
-        time_of_travel = parent->entity_intercept_time(this, current_target);
-        if (u(*random_generator) < target_forget_probability)
-          current_target = NULL;
+      if (target != NULL) {
+        time_of_travel = parent->entity_intercept_time(this, target);
+        if (u(rng) < target_forget_probability)
+          target = NULL;
       }
-      if (current_target == NULL && u(*random_generator) < prob_wants_food()) {
+      if (target == NULL && u(rng) < prob_wants_food()) {
         // Move to nearest food.
-        current_target = parent->nearest_target(this, time_of_travel, "food");
+        target = parent->nearest_target(this, time_of_travel, "food");
       }
-      if (current_target == NULL && u(*random_generator) < prob_wants_mate()) {
+      if (target == NULL && u(rng) < prob_wants_mate()) {
         // Move to nearest mate.
-        current_target = parent->nearest_target(this, time_of_travel, "mate");
+        target = parent->nearest_target(this, time_of_travel, "mate");
       }
+      // Other entities' pursuers change too, so this waits for the phase
+      // to end.
+      if (target != current_target_value())
+        deferred.targets.push_back({i, target});
     }
 
-    if (current_target != NULL && time_of_travel > 0.0) {
+    if (target != NULL && time_of_travel > 0.0) {
       double dx, dy;
 
-      parent->intecept_trajectory(this, current_target, time_of_travel, dpx,
-                                  dpy);
+      parent->intecept_trajectory(this, target, time_of_travel, dpx, dpy);
 
       dpx *= max_speed / ts;
       dpy *= max_speed / ts;
 
       norm = std::sqrt(dpx * dpx + dpy * dpy);
 
-      parent->minimum_vector(this, current_target, dx, dy);
+      parent->minimum_vector(this, target, dx, dy);
       dist = std::sqrt(pow(dx, 2) + pow(dy, 2));
       dpx /= std::max(norm / dist, 1.0);
       dpy /= std::max(norm / dist, 1.0);
@@ -284,66 +364,49 @@ void Entity::move() {
       //           << ", dpy: " << dpy << std::endl;
 
       if (std::isnan(dpx) || std::isnan(dpy)) {
-        std::cout << x << " " << y << " " << current_target->x << " "
-                  << current_target->y << std::endl;
+        std::cout << p.x[i] << " " << p.y[i] << " " << target->x_value() << " "
+                  << target->y_value() << std::endl;
         assert(false);
       }
 
       // Add a little jitter.
-      dpx += 0.2 * max_speed * d(*random_generator);
-      dpy += 0.2 * max_speed * d(*random_generator);
+      dpx += 0.2 * max_speed * d(rng);
+      dpy += 0.2 * max_speed * d(rng);
     } else {
       // Random walk.
-      dpx = max_speed * d(*random_generator);
-      dpy = max_speed * d(*random_generator);
+      dpx = max_speed * d(rng);
+      dpy = max_speed * d(rng);
     }
     px += dpx;
     py += dpy;
-    adjust_energy(-0.0002 * std::sqrt(abs(px * dpx) + abs(py * dpy)));
+    de = -0.0002 * std::sqrt(std::abs(px * dpx) + std::abs(py * dpy));
   }
 
-  x += px;
-  if (x > parent->x_size_value()) {
-    x -= parent->x_size_value();
-  } else if (x < 0) {
-    x += parent->x_size_value();
-  }
-
-  y += py;
-  if (y > parent->y_size_value()) {
-    y -= parent->y_size_value();
-  } else if (y < 0) {
-    y += parent->y_size_value();
-  }
-
-  for (auto &elem : parasites) {
-    elem->x = x;
-    elem->y = y;
-    elem->px = 0.0;
-    elem->py = 0.0;
-  }
+  deferred.motions.push_back({i, px, py, de});
 }
 
-int Entity::genome_distance(const std::vector<unsigned short> *a,
-                            const std::vector<unsigned short> *b) const {
-  assert(a->size() == b->size());
-
-  int dist = 0;
-  for (int i = 0; i < a->size(); i++) {
-    dist += abs(a->at(i) - b->at(i));
-  }
+void Entity::detach_from_host() {
+  remove_item_from_vector(host_value()->parasites, handle);
+  assign_host(NULL);
+  enter_grid();
+  parent->log_event(Event::born, this);
+}
 
-  return dist;
+int Entity::genome_distance(Genome a, Genome b) const {
+  return std::bitset<32>(a ^ b).count();
 }
 
+// String-keyed lookup for tooling; simulation code uses gene<Trait>().
 int Entity::gene_value(std::string trait) const {
-  return genome[parent->trait_index(trait)];
+  return population->gene(index, parent->trait_index(trait));
 }
 
 int Entity::parasite_count() const { return parasites.size(); }
 
+const std::vector<Handle> &Entity::pursuers_value() const { return pursuers; }
+
 void Entity::interact(Entity &other) {
-  int dist = genome_distance(&genome, other.genome_value());
+  int dist = genome_distance(genome_value(), other.genome_value());
 
   if (dist <= mood_distance) {
     adjust_mood(1);
@@ -357,83 +420,115 @@ void Entity::interact(Entity &other) {
   //           << other.mood_value() << std::endl;
 }
 
-void Entity::set_genome(std::vector<unsigned short> new_genome) {
-  genome = new_genome;
+void Entity::set_genome(Genome new_genome) {
+  population->genome[index] = new_genome;
+  population->derive(index);
 }
 
 Entity *Entity::mate(Entity &other) {
-  std::uniform_int_distribution<int> gene(0, 1);
-  std::string new_name = "(" + name + " + " + other.name + ")";
+  std::uniform_int_distribution<int> allele(0, 1);
+  RandomStream rng = random_stream(Site::mate, other.id);
 
-  energy -= mate_energy();
-  other.energy -= other.mate_energy();
+  population->energy[index] -= mate_energy();
+  population->energy[other.index] -= other.mate_energy();
 
   Entity *new_host = NULL;
 
   bool impregnates =
-      gene_value("gestates/not") | other.gene_value("gestates/not");
+      gene<Trait::gestates>() | other.gene<Trait::gestates>();
 
   double new_x, new_y;
 
   if (impregnates) {
-    new_host = gene_value("gestates/not") ? this : &other;
-    if (new_host == this) {
-      new_x = x;
-      new_y = y;
-    } else {
-      new_x = other.x;
-      new_y = other.y;
-    }
+    new_host = gene<Trait::gestates>() ? this : &other;
+    new_x = new_host->x_value();
+    new_y = new_host->y_value();
   } else {
-    double spawn_d = gene_value("geodispersal embryos/not") ? 5 : 250;
-    new_x = 0.5 * (x + other.x) + spawn_d * d(*random_generator);
-    new_y = 0.5 * (y + other.y) + spawn_d * d(*random_generator);
+    double spawn_d = gene<Trait::geodispersal_embryos>() ? 5 : 250;
+    new_x = 0.5 * (x_value() + other.x_value()) +
+            spawn_d * d(rng);
+    new_y = 0.5 * (y_value() + other.y_value()) +
+            spawn_d * d(rng);
   }
 
   double offspring_mass = conception_mass_coefficient * 0.5 *
                           (current_mass() + other.current_mass());
 
-  if (gene_value("geodispersal gametophytes/not") &
-      other.gene_value("geodispersal gametophytes/not")) {
+  if (gene<Trait::geodispersal_gametophytes>() &
+      other.gene<Trait::geodispersal_gametophytes>()) {
     offspring_mass *= 0.1;
   }
 
-  std::vector<unsigned short> new_genome = genome;
-  for (int i = 0; i < new_genome.size(); i++) {
-    if (gene(*random_generator) == 1) {
-      new_genome[i] = other.genome[i];
-      if (u(*random_generator) < other.prob_mutation())
-        new_genome[i] = 1 - new_genome[i];
+  Genome genome = genome_value();
+  Genome other_genome = other.genome_value();
+  Genome new_genome = genome;
+  for (int t = 0; t < num_traits; t++) {
+    Genome bit = trait_bit(Trait(t));
+    if (allele(rng) == 1) {
+      new_genome = (new_genome & ~bit) | (other_genome & bit);
+      if (u(rng) < other.prob_mutation())
+        new_genome ^= bit;
     }
-    if (u(*random_generator) < prob_mutation())
-      new_genome[i] = 1 - new_genome[i];
+    if (u(rng) < prob_mutation())
+      new_genome ^= bit;
   }
 
-  Entity *ret = new Entity(parent, new_name, new_x, new_y, offspring_mass,
-                           new_genome, new_host);
+  Entity *ret = new (*parent->get_entity_pool())
+      Entity(parent, std::string(), new_x, new_y, offspring_mass, &new_genome,
+             new_host, this, &other);
 
   if (impregnates) {
-    new_host->parasites.push_back(ret);
-    std::cout << name_hash() << " impregnated, now has "
-              << new_host->parasite_count() << " parasites." << std::endl;
+    new_host->parasites.push_back(ret->handle);
+    parent->log_event(Event::impregnated, this, NULL, NULL,
+                      new_host->parasite_count());
   }
 
   return ret;
 }
 
-void Entity::assign_host(Entity *entity) { host = entity; }
+void Entity::assign_host(Entity *entity) {
+  host = entity ? entity->handle : Handle();
+  if (entity)
+    population->flags[index] |= Population::HOSTED;
+  else
+    population->flags[index] &= ~Population::HOSTED;
+}
+
+void Entity::set_index(int new_index) { index = new_index; }
 
-bool Entity::will_mate_target(const Entity *target) const {
+// Only living entities that are not carried by a host take part in the
+// spatial grid; parasites follow their host and corpses don't interact.
+void Entity::enter_grid() {
+  int &cell = population->cell[index];
+  if (cell < 0 && alive_value() && host_value() == NULL)
+    cell = parent->get_grid()->insert(this, x_value(), y_value());
+}
+
+void Entity::leave_grid() {
+  int &cell = population->cell[index];
+  if (cell >= 0) {
+    parent->get_grid()->remove(this, cell);
+    cell = -1;
+  }
+}
+
+// `met` says that a pair of geodispersing gametophytes has already drawn
+// its chance of meeting at their distance, as distant pairs do in
+// State::mate_gametophytes().
+bool Entity::will_mate_target(const Entity *target, bool met) const {
   if (target->energy_value() < target->mate_energy())
     return false;
 
-  int genetic_diff = genome_distance(&genome, &target->genome);
+  int genetic_diff = genome_distance(genome_value(), target->genome_value());
 
   if (genetic_diff <= mating_distance) {
-    if (gene_value("geodispersal gametophytes/not") &
-        target->gene_value("geodispersal gametophytes/not")) {
-      double dist = std::sqrt(pow(x - target->x, 2) + pow(y - target->y, 2));
-      if (u(*random_generator) > pow(1.0 / dist, 2))
+    if (!met && (gene<Trait::geodispersal_gametophytes>() &
+                 target->gene<Trait::geodispersal_gametophytes>())) {
+      double dist = std::sqrt(pow(x_value() - target->x_value(), 2) +
+                              pow(y_value() - target->y_value(), 2));
+      // One draw per pair per tick, however often the pair is considered.
+      RandomStream rng = random_stream(Site::mate_target, target->id);
+      if (u(rng) > pow(1.0 / dist, 2))
         return false;
     }
     return true;
@@ -443,61 +538,70 @@ bool Entity::will_mate_target(const Entity *target) const {
 }
 
 bool Entity::can_eat_target(const Entity *target) const {
-  return target->energy > 0 && target->alive;
+  return target->energy_value() > 0 && target->alive_value();
 }
 
 bool Entity::will_eat_target(const Entity *target) const {
-  if (target->energy <= 0 || !target->alive ||
+  if (target->energy_value() <= 0 || !target->alive_value() ||
       current_strength() < target->current_strength())
     return false;
 
-  if (target->energy + target->kill_energy() < eating_energy())
+  if (target->energy_value() + target->kill_energy() < eating_energy())
     return false;
 
-  int dist = genome_distance(&genome, &target->genome);
+  int dist = genome_distance(genome_value(), target->genome_value());
 
-  if (dist > never_eat_distance &&
-      dist >= always_eat_distance *
-                  std::min(energy / (hunger_threshold * max_energy()), 1.0)) {
-    return true;
-  } else {
-    return false;
-  }
+  return dist >= min_eat_distance();
+}
+
+// How many bits a genome must differ by for this entity to eat its owner:
+// more than never_eat_distance, and up to always_eat_distance the better
+// fed it is.
+int Entity::min_eat_distance() const {
+  double fed = std::min(energy_value() / (hunger_threshold * max_energy()), 1.0);
+  return std::max(int(std::floor(never_eat_distance)) + 1,
+                  int(std::ceil(always_eat_distance * fed)));
 }
 
 void Entity::consume(Entity &target) {
-  if (target.will_die)
+  if (target.will_die_value())
     return;
 
-  current_target = NULL;
+  set_current_target(NULL);
 
-  double de = target.energy + target.kill_energy() - eating_energy();
+  double de = target.energy_value() + target.kill_energy() - eating_energy();
   adjust_energy(de);
-  adjust_mood(target.energy / target.max_energy());
-  target.energy = 0;
-  target.mood = 0;
-  target.px = 0;
-  target.py = 0;
-  target.will_die = true;
+  adjust_mood(target.energy_value() / target.max_energy());
+
+  const int t = target.index;
+  population->energy[t] = 0;
+  population->mood[t] = 0;
+  population->px[t] = 0;
+  population->py[t] = 0;
+  population->flags[t] |= Population::WILL_DIE;
 }
 
 void Entity::kill(bool remove_from_host) {
-  if (remove_from_host && host != NULL)
-    remove_item_from_vector(parasites, this);
-  will_die = false;
-  alive = false;
-  px = 0.0;
-  py = 0.0;
-  epoch_of_death = parent->epoch_value();
+  Entity *host_entity = host_value();
+  if (remove_from_host && host_entity != NULL)
+    remove_item_from_vector(host_entity->parasites, handle);
+
+  unsigned char &flags = population->flags[index];
+  flags &= ~(Population::WILL_DIE | Population::ALIVE);
+  population->px[index] = 0.0;
+  population->py[index] = 0.0;
+  population->epoch_of_death[index] = parent->epoch_value();
+  parent->get_genealogy()->set_death(id, parent->epoch_value());
+  leave_grid();
 
   // Kill all parasites as well.
-  std::cout << "Parasite count of killed entity (" << name_hash()
-            << "): " << parasite_count() << std::endl;
+  parent->log_event(Event::killed, this, NULL, NULL, parasite_count());
   for (auto &elem : parasites) {
-    std::cout << "Killing parasite named " << elem->name_hash() << std::endl;
-    elem->host = NULL;
-    elem->kill(false);
+    Entity *parasite = parent->entity_value(elem);
+    parent->log_event(Event::parasite_killed, parasite);
+    parasite->assign_host(NULL);
+    parasite->kill(false);
   }
 }
 
-void Entity::clear_current_target() { current_target = NULL; }
+void Entity::clear_current_target() { set_current_target(NULL); }
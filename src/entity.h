@@ -1,27 +1,39 @@
 #ifndef ENTITY_H
 #define ENTITY_H
 
+#include "population.h"
+#include "random.h"
+#include "slot_map.h"
 #include <random>
+#include <string>
+#include <vector>
 
+struct Deferred;
+class EntityPool;
 class State;
 class Entity {
 
 private:
   State *parent;
+  Population *population;
+  long id, parent_ids[2];
   std::string name;
-  bool alive, will_die;
-  Entity *host;
-  std::vector<Entity *> parasites;
-  double x, y;
-  double px, py;
-  double mood, energy, age, conception_mass;
-  long epoch_of_death;
-  const Entity *current_target;
-  std::default_random_engine *random_generator;
+  size_t name_hash_code;
+  int index;
+  Handle handle, host;
+  std::vector<Handle> parasites;
+  Handle current_target;
+  // Entities whose current target this is.
+  std::vector<Handle> pursuers;
   mutable std::normal_distribution<double> d;
-  mutable std::uniform_int_distribution<int> gene;
+  mutable std::uniform_int_distribution<int> allele;
   mutable std::uniform_real_distribution<double> u;
-  std::vector<unsigned short> genome;
+
+  Entity(State *, long, const long[2], const std::string &, size_t, int);
+  RandomStream random_stream(Site, long = -1) const;
+
+  friend class EntityPool;
+  friend class Snapshot;
 
 public:
   static constexpr double year = 86400 * 365;
@@ -51,11 +63,20 @@ public:
   static std::vector<std::string> all_traits;
 
   Entity(State *parent, const std::string &, double, double, double,
-         std::vector<unsigned short> = {}, Entity * = NULL);
+         const Genome * = NULL, Entity * = NULL, const Entity * = NULL,
+         const Entity * = NULL);
   ~Entity();
+  // Entities are only ever made in, and destroyed by, their world's pool.
+  static void *operator new(size_t, EntityPool &);
+  static void operator delete(void *, EntityPool &);
+  long id_value() const;
+  long parent_id_value(int) const;
   bool alive_value() const;
   bool will_die_value() const;
   Entity *host_value() const;
+  Handle handle_value() const;
+  int index_value() const;
+  int cell_value() const;
   double x_value() const;
   double y_value() const;
   double px_value() const;
@@ -66,7 +87,8 @@ public:
   double max_speed_value() const;
   std::string name_value() const;
   std::string name_hash() const;
-  const std::vector<unsigned short> *genome_value() const;
+  size_t name_hash_value() const;
+  Genome genome_value() const;
   const State *parent_value() const;
   const Entity *current_target_value() const;
 
@@ -90,27 +112,33 @@ public:
   bool will_mate() const;
   bool is_hungry() const;
   int gene_value(std::string) const;
+  template <Trait T> int gene() const { return population->gene<T>(index); }
   int parasite_count() const;
+  const std::vector<Handle> &pursuers_value() const;
 
   bool can_eat_target(const Entity *) const;
   bool will_eat_target(const Entity *) const;
-  bool will_mate_target(const Entity *) const;
+  int min_eat_distance() const;
+  bool will_mate_target(const Entity *, bool = false) const;
 
-  int genome_distance(const std::vector<unsigned short> *,
-                      const std::vector<unsigned short> *) const;
+  int genome_distance(Genome, Genome) const;
 
   void adjust_mood(double adjustment);
   void adjust_energy(double adjustment);
-  void adjust_needs();
-  void check_for_death();
-  void set_genome(std::vector<unsigned short>);
+  void set_genome(Genome);
   void consume(Entity &other);
   void kill(bool = true);
+  void set_current_target(const Entity *);
   void clear_current_target();
-  void move();
+  void drop_pursuers();
+  void move(Deferred &);
+  void detach_from_host();
   void interact(Entity &other);
   Entity *mate(Entity &other);
   void assign_host(Entity *);
+  void set_index(int);
+  void enter_grid();
+  void leave_grid();
 };
 
 #endif
@@ -0,0 +1,71 @@
+#include "entity_pool.h"
+#include <cassert>
+
+EntityPool::EntityPool() : free_list(NULL), capacity(0), in_use(0) {}
+
+// Adds a slab as big as the pool so far and threads it onto the free list,
+// lowest address first.
+void EntityPool::grow() {
+  size_t size = std::max(first_slab_size, capacity);
+  slabs.emplace_back(new Slot[size]);
+  Slot *slab = slabs.back().get();
+  for (size_t k = size; k-- > 0;) {
+    slab[k].next = free_list;
+    free_list = &slab[k];
+  }
+  capacity += size;
+}
+
+// Room for one entity; see Entity::operator new.
+void *EntityPool::allocate() {
+  if (free_list == NULL)
+    grow();
+  Slot *slot = free_list;
+  free_list = slot->next;
+  in_use++;
+  return slot;
+}
+
+void EntityPool::deallocate(void *memory) {
+  Slot *slot = static_cast<Slot *>(memory);
+  slot->next = free_list;
+  free_list = slot;
+  in_use--;
+}
+
+// Keeps the entity's vectors for later entities before destroying it.
+void EntityPool::release(Entity *entity) {
+  for (std::vector<Handle> *v : {&entity->parasites, &entity->pursuers}) {
+    if (v->capacity() > 0) {
+      v->clear();
+      spare_vectors.push_back(std::move(*v));
+    }
+  }
+  entity->~Entity();
+}
+
+void EntityPool::destroy(Entity *entity) {
+  release(entity);
+  deallocate(entity);
+}
+
+// Destroys a batch of entities, such as a tick's expired corpses, at once.
+void EntityPool::destroy(const std::vector<Entity *> &entities) {
+  for (auto &e : entities)
+    destroy(e);
+}
+
+// Gives an empty vector the storage of one an earlier entity left behind.
+void EntityPool::reuse(std::vector<Handle> &v) {
+  assert(v.empty());
+  if (spare_vectors.empty())
+    return;
+  v.swap(spare_vectors.back());
+  spare_vectors.pop_back();
+}
+
+size_t EntityPool::capacity_value() const { return capacity; }
+
+size_t EntityPool::in_use_value() const { return in_use; }
+
+int EntityPool::num_slabs() const { return slabs.size(); }
@@ -0,0 +1,47 @@
+#ifndef ENTITY_POOL_H
+#define ENTITY_POOL_H
+
+#include "entity.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Storage for a world's entities. Entities live in slabs that are never
+// freed until the pool is, and a destroyed entity's slot goes on a free
+// list for the next one; the handle vectors an entity owned are kept too
+// and handed to later entities, so churn through births and deaths stops
+// reaching the heap once the population has peaked. Each new slab is as
+// big as all the previous ones together.
+class EntityPool {
+
+private:
+  union Slot {
+    Slot *next;
+    alignas(Entity) unsigned char bytes[sizeof(Entity)];
+  };
+
+  static constexpr size_t first_slab_size = 256;
+
+  std::vector<std::unique_ptr<Slot[]>> slabs;
+  Slot *free_list;
+  size_t capacity, in_use;
+  std::vector<std::vector<Handle>> spare_vectors;
+
+  void grow();
+  void release(Entity *);
+
+public:
+  EntityPool();
+  EntityPool(const EntityPool &) = delete;
+  EntityPool &operator=(const EntityPool &) = delete;
+  void *allocate();
+  void deallocate(void *);
+  void destroy(Entity *);
+  void destroy(const std::vector<Entity *> &);
+  void reuse(std::vector<Handle> &);
+  size_t capacity_value() const;
+  size_t in_use_value() const;
+  int num_slabs() const;
+};
+
+#endif
@@ -0,0 +1,213 @@
+#include "event_log.h"
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+struct ThreadRing {
+  long serial;
+  void *ring;
+};
+
+// The ring this thread last used, tagged with the serial number of the log
+// it belongs to so that a later log at the same address isn't confused with
+// an earlier one.
+thread_local ThreadRing cached_ring = {-1, NULL};
+
+std::atomic<long> next_serial(0);
+
+std::string hex(uint64_t hash) {
+  std::stringstream stream;
+  stream << std::hex << hash;
+  return stream.str();
+}
+
+} // namespace
+
+EventLog::Ring::Ring(int size) : records(size), head(0), tail(0) {}
+
+// Opens `path` for writing, "-" meaning standard output, and starts the
+// writer thread.
+EventLog::EventLog(const std::string &path, Format format, int verbosity)
+    : format(format), verbosity(verbosity), serial(next_serial++),
+      flush_requested(0), flush_done(0), stopping(false) {
+  file = (path == "-") ? stdout : std::fopen(path.c_str(), "wb");
+  if (file != NULL && format == BINARY && !write_header(file)) {
+    std::fclose(file);
+    file = NULL;
+  }
+  writer = std::thread(&EventLog::write, this);
+}
+
+EventLog::~EventLog() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  writer.join();
+
+  if (file != NULL && file != stdout)
+    std::fclose(file);
+}
+
+bool EventLog::is_open() const { return file != NULL; }
+
+int EventLog::verbosity_value() const { return verbosity; }
+
+int EventLog::level(Event kind) {
+  switch (kind) {
+  case Event::population:
+    return POPULATION;
+  case Event::impregnated:
+  case Event::killed:
+  case Event::parasite_killed:
+    return DETAIL;
+  default:
+    return EVENTS;
+  }
+}
+
+bool EventLog::enabled(Event kind) const { return level(kind) <= verbosity; }
+
+EventLog::Ring *EventLog::thread_ring() {
+  if (cached_ring.serial == serial)
+    return static_cast<Ring *>(cached_ring.ring);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  rings.emplace_back(new Ring(ring_size));
+  cached_ring = {serial, rings.back().get()};
+  return rings.back().get();
+}
+
+// Appends an event to this thread's ring. Only the calling thread moves the
+// head and only the writer moves the tail, so no lock is needed.
+void EventLog::log(const EventRecord &record) {
+  if (!enabled(record.kind))
+    return;
+
+  Ring *ring = thread_ring();
+  unsigned long head = ring->head.load(std::memory_order_relaxed);
+  while (head - ring->tail.load(std::memory_order_acquire) >= ring_size) {
+    wake.notify_one();
+    std::this_thread::yield();
+  }
+
+  ring->records[head % ring_size] = record;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+// Blocks until every event logged before the call has been written.
+void EventLog::flush() {
+  std::unique_lock<std::mutex> lock(mutex);
+  long request = ++flush_requested;
+  wake.notify_one();
+  flushed.wait(lock, [&] { return flush_done >= request; });
+}
+
+void EventLog::drain(std::vector<EventRecord> &out) {
+  std::vector<Ring *> current;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &ring : rings)
+      current.push_back(ring.get());
+  }
+
+  for (Ring *ring : current) {
+    unsigned long tail = ring->tail.load(std::memory_order_relaxed);
+    unsigned long head = ring->head.load(std::memory_order_acquire);
+    for (; tail != head; tail++)
+      out.push_back(ring->records[tail % ring_size]);
+    ring->tail.store(tail, std::memory_order_release);
+  }
+}
+
+void EventLog::write() {
+  std::vector<EventRecord> records;
+
+  while (true) {
+    long request;
+    bool stop;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait_for(lock, std::chrono::milliseconds(10), [&] {
+        return stopping || flush_requested != flush_done;
+      });
+      request = flush_requested;
+      stop = stopping;
+    }
+
+    records.clear();
+    drain(records);
+
+    if (file != NULL && !records.empty()) {
+      if (format == BINARY) {
+        std::fwrite(records.data(), sizeof(EventRecord), records.size(), file);
+      } else {
+        for (auto &record : records) {
+          std::string line = format_line(record);
+          line += '\n';
+          std::fwrite(line.data(), 1, line.size(), file);
+        }
+      }
+    }
+    if (file != NULL)
+      std::fflush(file);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      flush_done = request;
+    }
+    flushed.notify_all();
+
+    if (stop)
+      return;
+  }
+}
+
+// The line the simulation printed for this event before it had a log.
+std::string EventLog::format_line(const EventRecord &record) {
+  std::string a = hex(record.hashes[0]);
+  std::string b = hex(record.hashes[1]);
+  std::string c = hex(record.hashes[2]);
+  std::string value = std::to_string(record.value);
+
+  switch (record.kind) {
+  case Event::born:
+    return a + " was born!";
+  case Event::impregnated:
+    return a + " impregnated, now has " + value + " parasites.";
+  case Event::ate:
+    return a + " ate " + b + "!";
+  case Event::mated:
+    return a + " and " + b + " mated (name: " + c + ").";
+  case Event::starved:
+    return "Entity " + a + " starved to death.";
+  case Event::died:
+    return "Entity " + a + " died of natural causes.";
+  case Event::killed:
+    return "Parasite count of killed entity (" + a + "): " + value;
+  case Event::parasite_killed:
+    return "Killing parasite named " + a;
+  case Event::population:
+    return "Entity count changed to: " + value;
+  default:
+    return "Unknown event " + std::to_string(int(record.kind));
+  }
+}
+
+bool EventLog::write_header(FILE *file) {
+  uint32_t fields[2] = {version, sizeof(EventRecord)};
+  return std::fwrite(magic, sizeof(magic), 1, file) == 1 &&
+         std::fwrite(fields, sizeof(fields), 1, file) == 1;
+}
+
+bool EventLog::read_header(FILE *file) {
+  char m[sizeof(magic)];
+  uint32_t fields[2];
+  return std::fread(m, sizeof(m), 1, file) == 1 &&
+         std::memcmp(m, magic, sizeof(magic)) == 0 &&
+         std::fread(fields, sizeof(fields), 1, file) == 1 &&
+         fields[0] == version && fields[1] == sizeof(EventRecord);
+}
@@ -0,0 +1,94 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class Event : uint8_t {
+  born,
+  impregnated,
+  ate,
+  mated,
+  starved,
+  died,
+  killed,
+  parasite_killed,
+  population,
+  count
+};
+
+// One simulation event. Entities are given by id and by the hash of their
+// name, which is what the human-readable lines print.
+struct EventRecord {
+  int64_t epoch;
+  int64_t ids[3];
+  uint64_t hashes[3];
+  int32_t value;
+  Event kind;
+  uint8_t padding[3];
+};
+
+static_assert(sizeof(EventRecord) == 64, "EventRecord layout changed");
+
+// Collects events from any number of threads and writes them out from a
+// background thread, either as binary records or as the human-readable lines
+// the simulation used to print. Each producing thread appends to its own
+// lock-free ring buffer; when a ring is full the producer waits for the
+// writer rather than dropping events.
+class EventLog {
+
+public:
+  // Events at or below the log's verbosity are recorded.
+  enum Level { SILENT, POPULATION, EVENTS, DETAIL };
+  enum Format { BINARY, TEXT };
+
+  static constexpr char magic[8] = {'T', 'E', 'C', 'H', 'L', 'O', 'G', '\0'};
+  static constexpr uint32_t version = 1;
+
+private:
+  struct Ring {
+    std::vector<EventRecord> records;
+    std::atomic<unsigned long> head, tail;
+
+    Ring(int);
+  };
+
+  static constexpr int ring_size = 1 << 14;
+
+  FILE *file;
+  Format format;
+  int verbosity;
+  long serial;
+  std::vector<std::unique_ptr<Ring>> rings;
+  std::mutex mutex;
+  std::condition_variable wake, flushed;
+  long flush_requested, flush_done;
+  bool stopping;
+  std::thread writer;
+
+  Ring *thread_ring();
+  void write();
+  void drain(std::vector<EventRecord> &);
+
+public:
+  EventLog(const std::string &, Format = BINARY, int = DETAIL);
+  ~EventLog();
+  bool is_open() const;
+  int verbosity_value() const;
+  bool enabled(Event) const;
+  void log(const EventRecord &);
+  void flush();
+  static int level(Event);
+  static std::string format_line(const EventRecord &);
+  static bool write_header(FILE *);
+  static bool read_header(FILE *);
+};
+
+#endif
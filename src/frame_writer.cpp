@@ -0,0 +1,115 @@
+#include "frame_writer.h"
+#include "state.h"
+#include <algorithm>
+#include <cmath>
+
+// For PNG, `path` is a prefix, frame k going to `path` followed by k as six
+// digits and ".png"; for RAW it's the file to write, "-" meaning standard
+// output. Frames cover an x_size by y_size world at `scale` pixels to a
+// unit.
+FrameWriter::FrameWriter(const std::string &path, Format format, double x_size,
+                         double y_size, double scale, long every)
+    : path(path), format(format), raw(NULL), scale(scale),
+      every(std::max(every, 1l)), frames(0),
+      framebuffer(sprites, std::max(int(std::round(x_size * scale)), 1),
+                  std::max(int(std::round(y_size * scale)), 1)),
+      stopping(false), failed(false) {
+  if (format == RAW)
+    raw = (path == "-") ? stdout : std::fopen(path.c_str(), "wb");
+  writer = std::thread(&FrameWriter::write, this);
+}
+
+FrameWriter::~FrameWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  writer.join();
+
+  if (raw != NULL && raw != stdout)
+    std::fclose(raw);
+  else if (raw == stdout)
+    std::fflush(stdout);
+}
+
+bool FrameWriter::is_open() const { return format == PNG || raw != NULL; }
+
+// Whether a frame couldn't be written, e.g. because the disk is full or the
+// encoder went away.
+bool FrameWriter::failed_value() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return failed;
+}
+
+int FrameWriter::width_value() const { return framebuffer.width_value(); }
+
+int FrameWriter::height_value() const { return framebuffer.height_value(); }
+
+// Called after every tick; takes a frame every `every` ticks.
+void FrameWriter::capture(const State &state) {
+  long tick = state.epoch_value() / State::tick_time;
+  if (!is_open() || tick % every != 0)
+    return;
+
+  std::unique_ptr<RenderSnapshot> snapshot;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    room.wait(lock, [&] { return int(pending.size()) < max_pending; });
+    if (!spare.empty()) {
+      snapshot = std::move(spare.back());
+      spare.pop_back();
+    }
+  }
+  if (!snapshot)
+    snapshot.reset(new RenderSnapshot);
+
+  snapshot->capture(state);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(std::move(snapshot));
+  }
+  wake.notify_one();
+}
+
+// The writer thread: draws and writes frames in order until stopped and
+// nothing is left pending. After a failed write it keeps taking frames but
+// drops them, so that the simulation never blocks on a dead pipe.
+void FrameWriter::write() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wake.wait(lock, [&] { return stopping || !pending.empty(); });
+    if (pending.empty())
+      return;
+
+    std::unique_ptr<RenderSnapshot> snapshot = std::move(pending.front());
+    pending.pop_front();
+    bool ok = !failed;
+    lock.unlock();
+
+    if (ok)
+      ok = write_frame(*snapshot, frames);
+
+    lock.lock();
+    frames++;
+    failed = !ok;
+    spare.push_back(std::move(snapshot));
+    room.notify_one();
+  }
+}
+
+bool FrameWriter::write_frame(const RenderSnapshot &snapshot, long number) {
+  framebuffer.draw(snapshot, scale);
+
+  if (format == RAW)
+    return framebuffer.write_raw(raw);
+
+  char name[16];
+  std::snprintf(name, sizeof(name), "%06ld.png", number);
+  FILE *file = std::fopen((path + name).c_str(), "wb");
+  if (file == NULL)
+    return false;
+  bool ok = framebuffer.write_png(file);
+  return std::fclose(file) == 0 && ok;
+}
@@ -0,0 +1,62 @@
+#ifndef FRAME_WRITER_H
+#define FRAME_WRITER_H
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "circle_sprites.h"
+#include "framebuffer.h"
+#include "render_snapshot.h"
+
+class State;
+
+// Films a run: every few ticks, copies what's on screen into a snapshot and
+// hands it to a background thread that draws it into a Framebuffer and
+// writes it out, either as numbered PNG files or as raw RGB24 frames to one
+// file or pipe for an external encoder. The simulation only pays for the
+// copy, unless it gets max_pending frames ahead of the writer; then it
+// waits rather than dropping frames.
+class FrameWriter {
+
+public:
+  enum Format { PNG, RAW };
+
+private:
+  static constexpr int max_pending = 4;
+
+  std::string path;
+  Format format;
+  FILE *raw;
+  double scale;
+  long every;
+  long frames;
+  CircleSprites sprites;
+  Framebuffer framebuffer;
+  std::deque<std::unique_ptr<RenderSnapshot>> pending;
+  std::vector<std::unique_ptr<RenderSnapshot>> spare;
+  std::mutex mutex;
+  std::condition_variable wake, room;
+  bool stopping, failed;
+  std::thread writer;
+
+  void write();
+  bool write_frame(const RenderSnapshot &, long);
+
+public:
+  FrameWriter(const std::string &, Format, double, double, double = 1.0,
+              long = 1);
+  ~FrameWriter();
+  bool is_open() const;
+  bool failed_value();
+  int width_value() const;
+  int height_value() const;
+  void capture(const State &);
+};
+
+#endif
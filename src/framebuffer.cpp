@@ -0,0 +1,228 @@
+#include "framebuffer.h"
+#include "render_snapshot.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+  static const std::vector<uint32_t> table = [] {
+    std::vector<uint32_t> t(256);
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      t[n] = c;
+    }
+    return t;
+  }();
+  crc = ~crc;
+  for (size_t k = 0; k < size; k++)
+    crc = table[(crc ^ data[k]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+uint32_t adler32(const std::vector<uint8_t> &data) {
+  uint32_t a = 1, b = 0;
+  for (size_t k = 0; k < data.size(); k++) {
+    a = (a + data[k]) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+void put_u32(std::vector<uint8_t> &out, uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out.push_back(value >> shift);
+}
+
+// Writes a zlib stream of a single deflate block with the fixed Huffman
+// codes. The only matches sought are repeats of the byte three back, which
+// is all it takes to squeeze runs of one colour of RGB pixels, and frames
+// are mostly that.
+class Deflater {
+
+private:
+  std::vector<uint8_t> &out;
+  uint32_t bits;
+  int count;
+
+  void put(uint32_t value, int n) {
+    bits |= value << count;
+    count += n;
+    while (count >= 8) {
+      out.push_back(bits);
+      bits >>= 8;
+      count -= 8;
+    }
+  }
+
+  // Huffman codes go most significant bit first.
+  void put_code(uint32_t code, int n) {
+    uint32_t reversed = 0;
+    for (int k = 0; k < n; k++)
+      reversed |= ((code >> k) & 1) << (n - 1 - k);
+    put(reversed, n);
+  }
+
+  void symbol(int s) {
+    if (s < 144)
+      put_code(0x30 + s, 8);
+    else if (s < 256)
+      put_code(0x190 + s - 144, 9);
+    else if (s < 280)
+      put_code(s - 256, 7);
+    else
+      put_code(0xc0 + s - 280, 8);
+  }
+
+  // A match of `length` bytes at distance 3, distance code 2.
+  void match(int length) {
+    static const int base[] = {3,  4,  5,  6,  7,  8,  9,  10,  11,  13,
+                               15, 17, 19, 23, 27, 31, 35, 43,  51,  59,
+                               67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const int extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                4, 4, 4, 4, 5, 5, 5, 5, 0};
+    int k = 28;
+    while (base[k] > length)
+      k--;
+    symbol(257 + k);
+    put(length - base[k], extra[k]);
+    put_code(2, 5);
+  }
+
+public:
+  Deflater(std::vector<uint8_t> &out) : out(out), bits(0), count(0) {}
+
+  void compress(const std::vector<uint8_t> &data) {
+    out.push_back(0x78);
+    out.push_back(0x01);
+    put(1, 1);
+    put(1, 2);
+
+    size_t n = data.size();
+    for (size_t i = 0; i < n;) {
+      size_t length = 0;
+      if (i >= 3)
+        while (length < 258 && i + length < n &&
+               data[i + length] == data[i + length - 3])
+          length++;
+      if (length >= 3) {
+        match(length);
+        i += length;
+      } else {
+        symbol(data[i]);
+        i++;
+      }
+    }
+
+    symbol(256);
+    if (count > 0)
+      put(0, 8 - count);
+    put_u32(out, adler32(data));
+  }
+};
+
+bool write_chunk(FILE *file, const char *type, const std::vector<uint8_t> &data) {
+  std::vector<uint8_t> chunk;
+  put_u32(chunk, data.size());
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  put_u32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+  return std::fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size();
+}
+
+} // namespace
+
+Framebuffer::Framebuffer(const CircleSprites &sprites, int width, int height)
+    : sprites(sprites), width(width), height(height),
+      pixels(3 * size_t(width) * height, 0) {}
+
+// Draws everyone where they were at the snapshot, `scale` pixels to a unit
+// of the world.
+void Framebuffer::draw(const RenderSnapshot &snapshot, double scale) {
+  std::fill(pixels.begin(), pixels.end(), 0);
+
+  for (auto const &i : snapshot.entities) {
+    int x = std::floor(i.x * scale);
+    int y = std::floor(i.y * scale);
+    int hew = i.radius;
+
+    int radius = hew * scale;
+    blend(sprites.disc(radius), x, y, radius, i.rgba);
+
+    if (i.ring) {
+      radius = (hew + 3) * scale;
+      blend(sprites.ring(radius), x, y, radius, i.rgba);
+    }
+  }
+}
+
+// Blends a sprite, stretched to radius r if it's smaller, centred on the
+// pixel (x, y).
+void Framebuffer::blend(const CircleSprites::Sprite &sprite, int x, int y,
+                        int r, const uint8_t rgba[4]) {
+  const std::vector<uint8_t> &coverage = sprites.coverage_value();
+  int atlas_width = sprites.width_value();
+  int size = 2 * r + 1;
+
+  for (int row = std::max(0, r - y); row < size && y - r + row < height;
+       row++) {
+    const uint8_t *source =
+        &coverage[size_t(sprite.y + row * sprite.size / size) * atlas_width +
+                  sprite.x];
+    uint8_t *target = &pixels[3 * (size_t(y - r + row) * width)];
+    for (int column = std::max(0, r - x); column < size && x - r + column < width;
+         column++) {
+      int alpha = source[column * sprite.size / size] * rgba[3] / 255;
+      if (alpha == 0)
+        continue;
+      uint8_t *pixel = target + 3 * (x - r + column);
+      for (int c = 0; c < 3; c++)
+        pixel[c] = (rgba[c] * alpha + pixel[c] * (255 - alpha)) / 255;
+    }
+  }
+}
+
+int Framebuffer::width_value() const { return width; }
+
+int Framebuffer::height_value() const { return height; }
+
+const std::vector<uint8_t> &Framebuffer::pixels_value() const {
+  return pixels;
+}
+
+bool Framebuffer::write_png(FILE *file) const {
+  static const uint8_t signature[8] = {0x89, 'P',  'N',  'G',
+                                       '\r', '\n', 0x1a, '\n'};
+  if (std::fwrite(signature, 1, 8, file) != 8)
+    return false;
+
+  std::vector<uint8_t> header;
+  put_u32(header, width);
+  put_u32(header, height);
+  for (uint8_t b : {8, 2, 0, 0, 0}) // 8-bit RGB, no interlacing
+    header.push_back(b);
+
+  // Each row is preceded by its filter type, none.
+  size_t stride = 3 * size_t(width);
+  std::vector<uint8_t> rows;
+  rows.reserve((stride + 1) * height);
+  for (int y = 0; y < height; y++) {
+    rows.push_back(0);
+    rows.insert(rows.end(), pixels.begin() + y * stride,
+                pixels.begin() + (y + 1) * stride);
+  }
+  std::vector<uint8_t> data;
+  Deflater(data).compress(rows);
+
+  return write_chunk(file, "IHDR", header) && write_chunk(file, "IDAT", data) &&
+         write_chunk(file, "IEND", {});
+}
+
+// Raw RGB24 frames back to back, as `ffmpeg -f rawvideo -pix_fmt rgb24`
+// reads them.
+bool Framebuffer::write_raw(FILE *file) const {
+  return std::fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+}
@@ -0,0 +1,34 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "circle_sprites.h"
+
+struct RenderSnapshot;
+
+// A frame drawn in memory, without SDL, the way the game window draws it:
+// entities as discs of their colour and radius, with parasite rings, on
+// black. Pixels are 8-bit RGB, row by row from the top.
+class Framebuffer {
+
+private:
+  const CircleSprites &sprites;
+  int width, height;
+  std::vector<uint8_t> pixels;
+
+  void blend(const CircleSprites::Sprite &, int, int, int, const uint8_t[4]);
+
+public:
+  Framebuffer(const CircleSprites &, int, int);
+  void draw(const RenderSnapshot &, double = 1.0);
+  int width_value() const;
+  int height_value() const;
+  const std::vector<uint8_t> &pixels_value() const;
+  bool write_png(FILE *) const;
+  bool write_raw(FILE *) const;
+};
+
+#endif
@@ -1,63 +1,429 @@
 // Technological progress game
 
 #include <SDL2/SDL.h>
-#include <SDL2/SDL2_gfxPrimitives.h>
 #include <SDL2/SDL_ttf.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <ctime>
-#include <iostream>
+#include <memory>
 #include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "circle_sprites.h"
 #include "constants.h"
+#include "density_grid.h"
 #include "entity.h"
+#include "event_log.h"
+#include "render_snapshot.h"
 #include "state.h"
 #include "technology.h"
 #include "tree.h"
 
 using namespace std::chrono_literals;
 
-void draw_text(SDL_Renderer *renderer, TTF_Font *font, const char *text, int x,
-               int y, bool fast = false, bool centerh = false) {
-  SDL_Color color = {0xFF, 0xFF, 0xFF};
-  SDL_Surface *surface;
-  if (fast) {
-    surface = TTF_RenderText_Solid(font, text, color);
-  } else {
-    surface = TTF_RenderText_Blended(font, text, color);
+// Every printable ASCII glyph of a font, rasterised once into one texture,
+// from which strings are laid out as quads and drawn in one
+// SDL_RenderGeometry call per frame. No kerning, which labels don't need.
+class GlyphAtlas {
+
+private:
+  static constexpr int first = ' ', last = '~';
+  static constexpr int row_width = 512;
+
+  struct Glyph {
+    SDL_Rect rect;
+    int advance;
+  };
+
+  SDL_Texture *texture;
+  Glyph glyphs[last - first + 1];
+  int atlas_w, atlas_h;
+  std::vector<SDL_Vertex> vertices;
+  std::vector<int> indices;
+  int width, height;
+
+public:
+  GlyphAtlas(SDL_Renderer *, TTF_Font *);
+  ~GlyphAtlas();
+  int text_width(const char *) const;
+  void clear(int, int);
+  void add(const char *, int, int, bool = false);
+  void draw(SDL_Renderer *);
+};
+
+// Each glyph is rendered as it would be at the start of a string, so drawn
+// at the pen position it lines up the way TTF_RenderText would have it.
+GlyphAtlas::GlyphAtlas(SDL_Renderer *renderer, TTF_Font *font)
+    : texture(NULL), atlas_w(row_width), atlas_h(0), width(0), height(0) {
+  SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+  SDL_Surface *surfaces[last - first + 1];
+
+  int x = 0, y = 0, row_height = 0;
+  for (int c = first; c <= last; c++) {
+    Glyph &glyph = glyphs[c - first];
+    int minx, maxx, miny, maxy;
+    TTF_GlyphMetrics(font, c, &minx, &maxx, &miny, &maxy, &glyph.advance);
+
+    SDL_Surface *rendered = TTF_RenderGlyph_Blended(font, c, white);
+    surfaces[c - first] =
+        rendered ? SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_RGBA32, 0)
+                 : NULL;
+    SDL_FreeSurface(rendered);
+
+    SDL_Surface *surface = surfaces[c - first];
+    int w = surface ? surface->w : 0, h = surface ? surface->h : 0;
+    if (x + w > row_width) {
+      x = 0;
+      y += row_height + 1;
+      row_height = 0;
+    }
+    glyph.rect = {x, y, w, h};
+    x += w + 1;
+    row_height = std::max(row_height, h);
+  }
+  atlas_h = std::max(y + row_height, 1);
+
+  std::vector<uint8_t> pixels(4 * atlas_w * atlas_h, 0);
+  for (int c = first; c <= last; c++) {
+    SDL_Surface *surface = surfaces[c - first];
+    if (surface == NULL)
+      continue;
+    const SDL_Rect &rect = glyphs[c - first].rect;
+    SDL_LockSurface(surface);
+    for (int row = 0; row < rect.h; row++)
+      std::copy_n(static_cast<uint8_t *>(surface->pixels) +
+                      row * surface->pitch,
+                  4 * rect.w,
+                  &pixels[4 * ((rect.y + row) * atlas_w + rect.x)]);
+    SDL_UnlockSurface(surface);
+    SDL_FreeSurface(surface);
   }
-  SDL_Texture *message = SDL_CreateTextureFromSurface(renderer, surface);
 
-  int texW = 0;
-  int texH = 0;
-  SDL_QueryTexture(message, NULL, NULL, &texW, &texH);
+  texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32,
+                              SDL_TEXTUREACCESS_STATIC, atlas_w, atlas_h);
+  SDL_UpdateTexture(texture, NULL, pixels.data(), 4 * atlas_w);
+  SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+}
+
+GlyphAtlas::~GlyphAtlas() { SDL_DestroyTexture(texture); }
 
-  int dx = x;
-  int dy = y;
+int GlyphAtlas::text_width(const char *text) const {
+  int w = 0;
+  for (const char *c = text; *c; c++)
+    if (*c >= first && *c <= last)
+      w += glyphs[*c - first].advance;
+  return w;
+}
+
+// Starts a frame drawn to a `width` by `height` target; glyphs entirely
+// outside it are dropped.
+void GlyphAtlas::clear(int w, int h) {
+  vertices.clear();
+  indices.clear();
+  width = w;
+  height = h;
+}
 
+// Queues `text` with its top left corner, or the middle of its top edge if
+// `centerh`, at (x, y). Characters without a glyph are skipped.
+void GlyphAtlas::add(const char *text, int x, int y, bool centerh) {
   if (centerh)
-    dx -= texW / 2;
-  SDL_Rect dstrect = {dx, dy, texW, texH};
+    x -= text_width(text) / 2;
+
+  SDL_Color color = {0xFF, 0xFF, 0xFF, 0xFF};
+  for (const char *c = text; *c; c++) {
+    if (*c < first || *c > last)
+      continue;
+    const Glyph &glyph = glyphs[*c - first];
+    const SDL_Rect &rect = glyph.rect;
+    float left = x, top = y, right = x + rect.w, bottom = y + rect.h;
+    x += glyph.advance;
+    if (rect.w == 0 || left >= width || top >= height || right <= 0 ||
+        bottom <= 0)
+      continue;
+
+    float u0 = float(rect.x) / atlas_w, v0 = float(rect.y) / atlas_h;
+    float u1 = float(rect.x + rect.w) / atlas_w;
+    float v1 = float(rect.y + rect.h) / atlas_h;
+
+    int first_vertex = vertices.size();
+    vertices.push_back({{left, top}, color, {u0, v0}});
+    vertices.push_back({{right, top}, color, {u1, v0}});
+    vertices.push_back({{right, bottom}, color, {u1, v1}});
+    vertices.push_back({{left, bottom}, color, {u0, v1}});
+    for (int k : {0, 1, 2, 0, 2, 3})
+      indices.push_back(first_vertex + k);
+  }
+}
 
-  SDL_RenderCopy(renderer, message, NULL, &dstrect);
+void GlyphAtlas::draw(SDL_Renderer *renderer) {
+  if (!indices.empty())
+    SDL_RenderGeometry(renderer, texture, vertices.data(), vertices.size(),
+                       indices.data(), indices.size());
+}
+
+// A string drawn often but changed rarely, such as the date, kept as a
+// texture of its own and only rendered again when it changes. Unlike the
+// glyph atlas it keeps the font's kerning.
+class Label {
+
+private:
+  TTF_Font *font;
+  std::string text;
+  SDL_Texture *texture;
+  int w, h;
+
+public:
+  Label(TTF_Font *);
+  ~Label();
+  void draw(SDL_Renderer *, const std::string &, int, int);
+};
+
+Label::Label(TTF_Font *font) : font(font), texture(NULL), w(0), h(0) {}
+
+Label::~Label() { SDL_DestroyTexture(texture); }
+
+void Label::draw(SDL_Renderer *renderer, const std::string &new_text, int x,
+                 int y) {
+  if (texture == NULL || new_text != text) {
+    text = new_text;
+    SDL_DestroyTexture(texture);
+    SDL_Color color = {0xFF, 0xFF, 0xFF, 0xFF};
+    SDL_Surface *surface = TTF_RenderText_Blended(font, text.c_str(), color);
+    texture = SDL_CreateTextureFromSurface(renderer, surface);
+    SDL_FreeSurface(surface);
+    SDL_QueryTexture(texture, NULL, NULL, &w, &h);
+  }
 
-  SDL_FreeSurface(surface);
-  SDL_DestroyTexture(message);
+  SDL_Rect dstrect = {x, y, w, h};
+  SDL_RenderCopy(renderer, texture, NULL, &dstrect);
 }
 
-void simulation(State &state, SDL_Window *window) {
-  // Clock stuff.
-  constexpr std::chrono::nanoseconds tick(16ms);
-  constexpr int base_hew = 1;
+// Collects every circle of a frame as textured quads cut from the circle
+// sprites, tinted by vertex colour, and draws them all with one
+// SDL_RenderGeometry call. Works the same on the software renderer.
+class CircleBatch {
+
+private:
+  const CircleSprites &sprites;
+  SDL_Texture *texture;
+  std::vector<SDL_Vertex> vertices;
+  std::vector<int> indices;
+  int width, height;
+
+  void add(const CircleSprites::Sprite &, double, double, int,
+           const uint8_t[4]);
+
+public:
+  CircleBatch(SDL_Renderer *, const CircleSprites &);
+  ~CircleBatch();
+  void clear(int, int);
+  void disc(double, double, int, const uint8_t[4]);
+  void ring(double, double, int, const uint8_t[4]);
+  void draw(SDL_Renderer *);
+};
+
+// Uploads the sprites once as white with their coverage as alpha.
+CircleBatch::CircleBatch(SDL_Renderer *renderer, const CircleSprites &sprites)
+    : sprites(sprites), width(0), height(0) {
+  int w = sprites.width_value(), h = sprites.height_value();
+  const std::vector<uint8_t> &coverage = sprites.coverage_value();
+  std::vector<uint8_t> pixels(4 * coverage.size(), 255);
+  for (size_t k = 0; k < coverage.size(); k++)
+    pixels[4 * k + 3] = coverage[k];
+
+  texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32,
+                              SDL_TEXTUREACCESS_STATIC, w, h);
+  SDL_UpdateTexture(texture, NULL, pixels.data(), 4 * w);
+  SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+}
+
+CircleBatch::~CircleBatch() { SDL_DestroyTexture(texture); }
+
+// Starts a frame drawn to a `width` by `height` target; circles entirely
+// outside it are dropped.
+void CircleBatch::clear(int w, int h) {
+  vertices.clear();
+  indices.clear();
+  width = w;
+  height = h;
+}
 
-  int ew, hew;
+// A quad over the pixels the sprite covers when its middle pixel is the
+// one (x, y) falls in. Radii beyond the largest sprite stretch it.
+void CircleBatch::add(const CircleSprites::Sprite &sprite, double x, double y,
+                      int radius, const uint8_t rgba[4]) {
+  float left = std::floor(x) - radius, top = std::floor(y) - radius;
+  float size = 2 * radius + 1;
+  if (left >= width || top >= height || left + size <= 0 || top + size <= 0)
+    return;
+
+  float u0 = float(sprite.x) / sprites.width_value();
+  float v0 = float(sprite.y) / sprites.height_value();
+  float u1 = float(sprite.x + sprite.size) / sprites.width_value();
+  float v1 = float(sprite.y + sprite.size) / sprites.height_value();
+  SDL_Color color = {rgba[0], rgba[1], rgba[2], rgba[3]};
+
+  int first = vertices.size();
+  vertices.push_back({{left, top}, color, {u0, v0}});
+  vertices.push_back({{left + size, top}, color, {u1, v0}});
+  vertices.push_back({{left + size, top + size}, color, {u1, v1}});
+  vertices.push_back({{left, top + size}, color, {u0, v1}});
+  for (int k : {0, 1, 2, 0, 2, 3})
+    indices.push_back(first + k);
+}
+
+void CircleBatch::disc(double x, double y, int radius, const uint8_t rgba[4]) {
+  add(sprites.disc(radius), x, y, radius, rgba);
+}
+
+void CircleBatch::ring(double x, double y, int radius, const uint8_t rgba[4]) {
+  add(sprites.ring(radius), x, y, radius, rgba);
+}
+
+void CircleBatch::draw(SDL_Renderer *renderer) {
+  if (!indices.empty())
+    SDL_RenderGeometry(renderer, texture, vertices.data(), vertices.size(),
+                       indices.data(), indices.size());
+}
+
+// A density grid drawn as a texture, a texel to a cell.
+class GridTexture {
+
+private:
+  SDL_Texture *texture;
+  int columns, rows;
+  std::vector<uint8_t> pixels;
+
+public:
+  GridTexture();
+  ~GridTexture();
+  void update(SDL_Renderer *, const DensityGrid &, bool);
+  void draw(SDL_Renderer *, const SDL_Rect &);
+};
 
-  using clock = std::chrono::high_resolution_clock;
+GridTexture::GridTexture() : texture(NULL), columns(0), rows(0) {}
+
+GridTexture::~GridTexture() {
+  if (texture != NULL)
+    SDL_DestroyTexture(texture);
+}
+
+// Takes the grid's mean colours, or its heatmap if `heat`.
+void GridTexture::update(SDL_Renderer *renderer, const DensityGrid &grid,
+                         bool heat) {
+  if (texture == NULL || grid.columns_value() != columns ||
+      grid.rows_value() != rows) {
+    if (texture != NULL)
+      SDL_DestroyTexture(texture);
+    columns = grid.columns_value();
+    rows = grid.rows_value();
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32,
+                                SDL_TEXTUREACCESS_STREAMING,
+                                std::max(columns, 1), std::max(rows, 1));
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+  }
+  if (columns == 0 || rows == 0)
+    return;
+
+  if (heat)
+    grid.heat(pixels);
+  else
+    grid.average(pixels);
+  SDL_UpdateTexture(texture, NULL, pixels.data(), 4 * columns);
+}
+
+void GridTexture::draw(SDL_Renderer *renderer, const SDL_Rect &rect) {
+  if (columns > 0 && rows > 0)
+    SDL_RenderCopy(renderer, texture, NULL, &rect);
+}
+
+// What part of the world is on screen: the world position of the top left
+// corner, and output pixels to a unit of the world.
+struct View {
+  double x = 0.0, y = 0.0, zoom = 1.0;
+};
+
+// What the renderer tells the simulation about the mouse, in world units.
+struct Input {
+  std::atomic<bool> mouse_button_down{false};
+  std::atomic<double> mouse_x{0.0}, mouse_y{0.0};
+};
+
+// Runs the world at one tick per `tick` on its own thread, publishing a
+// snapshot after every tick, until `quit` is set. A simulation that falls
+// behind runs ticks back to back, dropping any backlog beyond
+// max_catch_up, and never waits for the renderer.
+void simulate(State &state, SnapshotExchange &exchange, const Input &input,
+              const std::atomic<bool> &quit) {
+  constexpr std::chrono::nanoseconds tick(16ms);
+  constexpr int max_catch_up = 10;
 
-  std::default_random_engine *random_generator = state.get_random_generator();
+  using clock = std::chrono::steady_clock;
+
+  // Only used to scatter clicked-in entities; the simulation itself draws
+  // from its own seeded streams.
+  std::default_random_engine random_generator(std::random_device{}());
 
   std::normal_distribution<double> normal_dist(0.0, 1.0);
 
-  std::chrono::nanoseconds lag(0ns);
+  long n_ticks = 0;
+  long n_clicks = 0;
+
+  exchange.back().capture(state);
+  exchange.publish();
+
+  auto next = clock::now() + tick;
+
+  while (!quit) {
+    auto now = clock::now();
+    if (now < next) {
+      std::this_thread::sleep_for(next - now);
+      continue;
+    }
+    next = std::max(next, now - max_catch_up * tick) + tick;
+
+    if (input.mouse_button_down) {
+      n_clicks++;
+      state.add_entity("c" + std::to_string(n_clicks),
+                       input.mouse_x + normal_dist(random_generator),
+                       input.mouse_y + normal_dist(random_generator));
+    }
+
+    n_ticks++;
+
+    if (n_ticks % 60 == 0) {
+      std::string new_name = "t" + std::to_string(n_ticks);
+      state.add_entity(new_name);
+    }
+
+    state.update();
+
+    exchange.back().capture(state);
+    exchange.publish();
+  }
+}
+
+// Draws the latest snapshot once per frame. Entities are drawn where they
+// were a fraction of a tick ago, between the last two positions, so motion
+// stays smooth whatever the frame rate.
+//
+// How much detail is drawn depends on how many entities are in view, which
+// the mouse wheel changes by zooming. Up to max_circles each is drawn as a
+// circle with its label; up to max_points, as a point per point_size
+// pixels in their mean colour; beyond that, or when zoomed out so far that
+// points would be no finer than it, as the snapshot's density heatmap,
+// which costs the same however many there are.
+void render(SDL_Window *window, SnapshotExchange &exchange, Input &input) {
+  constexpr double tick_seconds = 0.016;
+  constexpr long max_circles = 20000;
+  constexpr long max_points = 200000;
+  constexpr int point_size = 2;
+  constexpr double max_zoom = 16.0;
 
   // Font stuff.
   TTF_Font *font = TTF_OpenFont("../fonts/OpenSans-Regular.ttf", 24);
@@ -67,146 +433,159 @@ void simulation(State &state, SDL_Window *window) {
     printf("Failed to load lazy font! SDL_ttf Error: %s\n", TTF_GetError());
   }
 
-  // Main simulation loop.
-  auto start = clock::now();
+  SDL_Renderer *renderer = SDL_CreateRenderer(
+      window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+  if (renderer == NULL)
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+
+  CircleSprites sprites;
+  auto circles = std::make_unique<CircleBatch>(renderer, sprites);
+  auto labels = std::make_unique<GlyphAtlas>(renderer, small_font);
+  auto year = std::make_unique<Label>(font);
+  auto point_texture = std::make_unique<GridTexture>();
+  auto heat_texture = std::make_unique<GridTexture>();
+  DensityGrid points;
+  long heat_epoch = -1;
 
-  SDL_Renderer *renderer =
-      SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+  View view;
 
   bool quit = false;
 
   SDL_Event e;
 
-  long n_ticks = 0;
-  long n_clicks = 0;
+  while (!quit) {
+    const RenderSnapshot &snapshot = exchange.latest();
 
-  bool mouse_button_down = false;
-  int mouse_x, mouse_y;
+    int output_w, output_h, window_w, window_h;
+    SDL_GetRendererOutputSize(renderer, &output_w, &output_h);
+    SDL_GetWindowSize(window, &window_w, &window_h);
+    double pixel_ratio = double(output_w) / std::max(window_w, 1);
+
+    int mouse_x, mouse_y;
+    SDL_GetMouseState(&mouse_x, &mouse_y);
+    double pointer_x = mouse_x * pixel_ratio, pointer_y = mouse_y * pixel_ratio;
 
-  while (!quit) {
     while (SDL_PollEvent(&e) != 0) {
       // User requests quit
       if (e.type == SDL_QUIT) {
         quit = true;
       } else if (e.type == SDL_MOUSEBUTTONDOWN) {
-        mouse_button_down = true;
+        input.mouse_button_down = true;
       } else if (e.type == SDL_MOUSEBUTTONUP) {
-        mouse_button_down = false;
+        input.mouse_button_down = false;
+      } else if (e.type == SDL_MOUSEWHEEL) {
+        // Zooms about the pointer, no further out than the whole world.
+        double min_zoom = std::min(1.0, std::min(output_w / snapshot.x_size,
+                                                 output_h / snapshot.y_size));
+        double zoom = std::min(
+            max_zoom,
+            std::max(min_zoom, view.zoom * std::pow(1.25, e.wheel.y)));
+        view.x += pointer_x / view.zoom - pointer_x / zoom;
+        view.y += pointer_y / view.zoom - pointer_y / zoom;
+        view.zoom = zoom;
       }
     }
 
-    auto dt = clock::now() - start;
-    start = clock::now();
-    lag += std::chrono::duration_cast<std::chrono::nanoseconds>(dt);
+    input.mouse_x = view.x + pointer_x / view.zoom;
+    input.mouse_y = view.y + pointer_y / view.zoom;
 
-    // SDL_Delay(subtick);
+    std::chrono::duration<double> since =
+        std::chrono::steady_clock::now() - snapshot.time;
+    double behind = 1.0 - std::min(since.count() / tick_seconds, 1.0);
 
-    while (lag >= tick) {
-      if (mouse_button_down) {
-        n_clicks++;
-        SDL_GetMouseState(&mouse_x, &mouse_y);
-        std::cout << "Mouse click!" << std::endl;
-        state.add_entity("c" + std::to_string(n_clicks),
-                         2 * mouse_x + normal_dist(*random_generator),
-                         2 * mouse_y + normal_dist(*random_generator));
-      }
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
 
-      n_ticks++;
+    const DensityGrid &density = snapshot.density;
+    long in_view =
+        density.count(view.x, view.y, view.x + output_w / view.zoom,
+                      view.y + output_h / view.zoom);
 
-      lag -= tick;
+    if (in_view <= max_circles) {
+      circles->clear(output_w, output_h);
+      labels->clear(output_w, output_h);
 
-      if (n_ticks % 60 == 0) {
-        std::string new_name = "t" + std::to_string(n_ticks);
-        state.add_entity(new_name);
-      }
+      for (auto const &i : snapshot.entities) {
+        double x = (i.x - behind * i.px - view.x) * view.zoom;
+        double y = (i.y - behind * i.py - view.y) * view.zoom;
+        int hew = i.radius * view.zoom;
+
+        circles->disc(x, y, hew, i.rgba);
+
+        if (i.ring)
+          circles->ring(x, y, hew + 3, i.rgba);
 
-      state.update();
-
-      SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-      SDL_RenderClear(renderer);
-
-      const char *text = ("Year: " + state.date_str()).c_str();
-      draw_text(renderer, font, text, 0, 0, true, false);
-
-      int render_count = 0;
-      std::vector<int> rgba(4);
-      for (auto const &i : state.entities_value()) {
-        render_count++;
-        double death_scale =
-            (i->alive_value() ? 1.0
-                              : (0.9 *
-                                     std::max(Entity::corpse_lifetime -
-                                                  i->time_since_death(),
-                                              0.0) /
-                                     Entity::corpse_lifetime +
-                                 0.1));
-        if (i->age_since_birth() < Entity::mating_age) {
-          rgba = {0, 0, int(std::floor(death_scale * 255)), 255};
-        } else if (i->age_since_birth() > i->impotence_age()) {
-          rgba = {int(std::floor(death_scale * 255)), 0,
-                  int(std::floor(death_scale * 255)), 255};
-        } else {
-          double mood_scale =
-              0.5 * (1.0 + 2.0 / PI * std::atan(i->mood_value()));
-          rgba = {int(std::floor(255 * death_scale * (1.0 - mood_scale))),
-                  int(std::floor(255 * death_scale * mood_scale)), 0, 255};
-        }
-
-        hew = std::max(base_hew * i->current_mass(), 1.0);
-        ew = 2 * hew;
-
-        // DrawFilledCircle(renderer, i->x_value(), i->y_value(), hew);
-
-        filledCircleRGBA(renderer, i->x_value(), i->y_value(), hew, rgba[0],
-                         rgba[1], rgba[2], rgba[3]);
-
-        int pc = i->parasite_count();
-        if (i->host_value() == NULL && pc > 0) {
-          for (int p = 0; p < pc; p++) {
-            if (pc == 1) {
-              circleRGBA(renderer, i->x_value(), i->y_value(), hew + 3,
-                         rgba[0], rgba[1], rgba[2], rgba[3]);
-            }
-          }
-        }
-
-        // std::string status;
-        //
-        // if (i->host_value() == NULL) {
-        //   if (!i->alive_value()) {
-        //     status += "d";
-        //   } else {
-        //     if (i->is_hungry())
-        //       status += "h";
-        //     if (i->will_mate())
-        //       status += "m";
-        //     if (i->parasite_count())
-        //       status += std::to_string(i->parasite_count());
-        //   }
-        // }
-        //
-        // if (status != "") {
-        //   draw_text(renderer, small_font, status.c_str(), i->x_value(),
-        //             i->y_value() + hew, true, true);
-        // }
+        if (i.status[0])
+          labels->add(i.status, x, y + hew, true);
       }
 
-      SDL_RenderPresent(renderer);
-      SDL_UpdateWindowSurface(window);
+      circles->draw(renderer);
+      labels->draw(renderer);
+    } else if (in_view <= max_points &&
+               density.cell_size_value() * view.zoom > point_size) {
+      points.reset((output_w + point_size - 1) / point_size,
+                   (output_h + point_size - 1) / point_size, view.x, view.y,
+                   point_size / view.zoom);
+      for (auto const &i : snapshot.entities)
+        points.add(i.x - behind * i.px, i.y - behind * i.py, i.rgba);
+
+      point_texture->update(renderer, points, false);
+      point_texture->draw(renderer,
+                          {0, 0, points.columns_value() * point_size,
+                           points.rows_value() * point_size});
+    } else {
+      if (snapshot.epoch != heat_epoch) {
+        heat_texture->update(renderer, density, true);
+        heat_epoch = snapshot.epoch;
+      }
+      double cell = density.cell_size_value() * view.zoom;
+      heat_texture->draw(
+          renderer,
+          {int(std::round((density.x0_value() - view.x) * view.zoom)),
+           int(std::round((density.y0_value() - view.y) * view.zoom)),
+           int(std::round(density.columns_value() * cell)),
+           int(std::round(density.rows_value() * cell))});
     }
+
+    year->draw(renderer, "Year: " + snapshot.date, 0, 0);
+
+    // Waits for vsync.
+    SDL_RenderPresent(renderer);
   }
 
+  circles.reset();
+  labels.reset();
+  year.reset();
+  point_texture.reset();
+  heat_texture.reset();
   SDL_DestroyRenderer(renderer);
 
   TTF_CloseFont(font);
   TTF_CloseFont(small_font);
 }
 
+// Rendering stays on the main thread, where SDL wants it; the world runs on
+// a thread of its own.
+void simulation(State &state, SDL_Window *window) {
+  SnapshotExchange exchange;
+  Input input;
+  std::atomic<bool> quit(false);
+
+  std::thread simulator(simulate, std::ref(state), std::ref(exchange),
+                        std::cref(input), std::cref(quit));
+  render(window, exchange, input);
+
+  quit = true;
+  simulator.join();
+}
+
 int main() {
   constexpr double x_size = 1280 * 2;
   constexpr double y_size = 800 * 2;
 
   State state(100.0, 0l, x_size, y_size);
+  EventLog event_log("-", EventLog::TEXT);
+  state.set_event_log(&event_log);
 
   for (int i = 0; i < 40; i++) {
     std::string name = std::to_string(i);
@@ -0,0 +1,74 @@
+#include "genealogy.h"
+#include <cassert>
+
+void Genealogy::add(long id, long birth, Genome genome, long parent_a,
+                    long parent_b) {
+  assert(id == tree.size());
+  tree.add(Lineage{birth, -1, genome}, parent_a, parent_b);
+}
+
+void Genealogy::set_death(long id, long epoch) {
+  tree[id].data_value().death = epoch;
+}
+
+int Genealogy::size() const { return tree.size(); }
+
+void Genealogy::clear() { tree.clear(); }
+
+const Lineage &Genealogy::lineage_value(long id) const {
+  return tree[id].data_value();
+}
+
+long Genealogy::parent_value(long id, int k) const {
+  return tree[id].parent_value(k);
+}
+
+void Genealogy::ancestors(long id, std::vector<int> &out) const {
+  tree.ancestors(id, out);
+}
+
+void Genealogy::descendants(long id, std::vector<int> &out) const {
+  tree.descendants(id, out);
+}
+
+bool Genealogy::is_ancestor(long ancestor, long id) const {
+  return tree.is_ancestor(ancestor, id);
+}
+
+long Genealogy::common_ancestor(long a, long b) const {
+  return tree.common_ancestor(a, b);
+}
+
+// Whether the entity or any of its descendants is still alive.
+bool Genealogy::lineage_survives(long id) const {
+  if (lineage_value(id).death < 0)
+    return true;
+  std::vector<int> below;
+  tree.descendants(id, below);
+  for (int d : below) {
+    if (tree[d].data_value().death < 0)
+      return true;
+  }
+  return false;
+}
+
+// How many of the entities that were spawned rather than born still have a
+// living descendant (or are alive themselves). Children come after their
+// parents, so one backwards pass carries survival up the whole tree.
+int Genealogy::num_surviving_lineages() const {
+  std::vector<char> survives(tree.size(), 0);
+  int count = 0;
+
+  for (int i = tree.size() - 1; i >= 0; i--) {
+    const Node<Lineage> &node = tree[i];
+    survives[i] |= node.data_value().death < 0;
+    int a = node.parent_value(0), b = node.parent_value(1);
+    if (a >= 0)
+      survives[a] |= survives[i];
+    if (b >= 0)
+      survives[b] |= survives[i];
+    if (a < 0 && b < 0)
+      count += survives[i];
+  }
+  return count;
+}
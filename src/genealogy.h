@@ -0,0 +1,38 @@
+#ifndef GENEALOGY_H
+#define GENEALOGY_H
+
+#include "traits.h"
+#include "tree.h"
+#include <vector>
+
+// What the genealogy keeps about every entity that ever existed. Ticks are
+// epochs; death is -1 while the entity lives.
+struct Lineage {
+  long birth, death;
+  Genome genome;
+};
+
+// The family tree of every entity since the world began, kept after corpses
+// are erased. Entity ids are handed out in order and every entity is added
+// as it is created, so an entity's id is its index in the tree.
+class Genealogy {
+
+private:
+  Tree<Lineage> tree;
+
+public:
+  void add(long, long, Genome, long = -1, long = -1);
+  void set_death(long, long);
+  int size() const;
+  void clear();
+  const Lineage &lineage_value(long) const;
+  long parent_value(long, int) const;
+  void ancestors(long, std::vector<int> &) const;
+  void descendants(long, std::vector<int> &) const;
+  bool is_ancestor(long, long) const;
+  long common_ancestor(long, long) const;
+  bool lineage_survives(long) const;
+  int num_surviving_lineages() const;
+};
+
+#endif
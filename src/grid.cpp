@@ -0,0 +1,103 @@
+#include "grid.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+// Cells are at least `min_cell_size` wide and tile the periodic domain
+// exactly, so every pair closer than `min_cell_size` (including pairs that
+// straddle a boundary) lies within the 3x3 block around either member.
+Grid::Grid(double x_size, double y_size, double min_cell_size)
+    : x_size(x_size), y_size(y_size) {
+  nx = std::max(1, int(std::floor(x_size / min_cell_size)));
+  ny = std::max(1, int(std::floor(y_size / min_cell_size)));
+  cell_width = x_size / nx;
+  cell_height = y_size / ny;
+  cells = std::vector<std::vector<Entity *>>(nx * ny);
+}
+
+int Grid::cell_index(double x, double y) const {
+  int ix = int(std::floor(x / cell_width)) % nx;
+  int iy = int(std::floor(y / cell_height)) % ny;
+  if (ix < 0)
+    ix += nx;
+  if (iy < 0)
+    iy += ny;
+  return iy * nx + ix;
+}
+
+int Grid::insert(Entity *entity, double x, double y) {
+  int cell = cell_index(x, y);
+  cells[cell].push_back(entity);
+  return cell;
+}
+
+int Grid::move(Entity *entity, int cell, double x, double y) {
+  int new_cell = cell_index(x, y);
+  if (new_cell == cell)
+    return cell;
+  remove(entity, cell);
+  cells[new_cell].push_back(entity);
+  return new_cell;
+}
+
+void Grid::remove(Entity *entity, int cell) {
+  std::vector<Entity *> &members = cells[cell];
+  auto iter = std::find(members.begin(), members.end(), entity);
+  assert(iter != members.end());
+  *iter = members.back();
+  members.pop_back();
+}
+
+// For restoring a saved grid in its original per-cell order: size each cell
+// first, then place every member at its saved position.
+void Grid::resize_cell(int cell, int size) { cells[cell].resize(size); }
+
+void Grid::place(Entity *entity, int cell, int position) {
+  assert(cells[cell][position] == NULL);
+  cells[cell][position] = entity;
+}
+
+void Grid::clear() {
+  for (auto &c : cells)
+    c.clear();
+}
+
+int Grid::num_cells() const { return cells.size(); }
+
+const std::vector<Entity *> &Grid::cell_value(int cell) const {
+  return cells[cell];
+}
+
+int Grid::neighbour_cells(int cell, int out[9]) const {
+  int ix = cell % nx;
+  int iy = cell / nx;
+  int count = 0;
+
+  // Grids narrower than three cells wrap onto themselves; skip duplicates so
+  // that no pair is visited twice.
+  for (int dy = -1; dy <= 1; dy++) {
+    int cy = (iy + dy + ny) % ny;
+    for (int dx = -1; dx <= 1; dx++) {
+      int cx = (ix + dx + nx) % nx;
+      int c = cy * nx + cx;
+      if (std::find(out, out + count, c) == out + count)
+        out[count++] = c;
+    }
+  }
+
+  return count;
+}
+
+bool Grid::are_neighbours(int a, int b) const {
+  int dx = std::abs(a % nx - b % nx);
+  int dy = std::abs(a / nx - b / nx);
+  return std::min(dx, nx - dx) <= 1 && std::min(dy, ny - dy) <= 1;
+}
+
+double Grid::periodic_d2(double x1, double y1, double x2, double y2) const {
+  double dx = std::fmod(std::abs(x1 - x2), x_size);
+  double dy = std::fmod(std::abs(y1 - y2), y_size);
+  dx = std::min(dx, x_size - dx);
+  dy = std::min(dy, y_size - dy);
+  return dx * dx + dy * dy;
+}
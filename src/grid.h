@@ -0,0 +1,31 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <vector>
+
+class Entity;
+class Grid {
+
+private:
+  double x_size, y_size;
+  double cell_width, cell_height;
+  int nx, ny;
+  std::vector<std::vector<Entity *>> cells;
+
+public:
+  Grid(double, double, double);
+  int cell_index(double, double) const;
+  int insert(Entity *, double, double);
+  int move(Entity *, int, double, double);
+  void remove(Entity *, int);
+  void resize_cell(int, int);
+  void place(Entity *, int, int);
+  void clear();
+  int num_cells() const;
+  const std::vector<Entity *> &cell_value(int) const;
+  int neighbour_cells(int, int[9]) const;
+  bool are_neighbours(int, int) const;
+  double periodic_d2(double, double, double, double) const;
+};
+
+#endif
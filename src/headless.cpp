@@ -0,0 +1,279 @@
+// Technological progress game, without a display: runs the simulation as
+// fast as possible for batch and production runs.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "entity.h"
+#include "event_log.h"
+#include "frame_writer.h"
+#include "recorder.h"
+#include "snapshot.h"
+#include "state.h"
+
+struct Options {
+  unsigned long seed = std::random_device()();
+  double x_size = 1280 * 2;
+  double y_size = 800 * 2;
+  int population = 40;
+  long spawn_every = 60;
+  long ticks = 10000;
+  long report_every = 0;
+  int threads = std::max(int(std::thread::hardware_concurrency()), 1);
+  int verbosity = EventLog::DETAIL;
+  std::string events;
+  std::string load, save;
+  long save_every = 0;
+  std::string series;
+  long series_every = 1;
+  std::string frames, frames_raw;
+  long frame_every = 10;
+  double frame_scale = 1.0;
+};
+
+void usage(const char *name) {
+  std::cerr
+      << "Usage: " << name << " [options]\n"
+      << "  --seed N          seed for the world's random generator\n"
+      << "  --width W         world width (default 2560)\n"
+      << "  --height H        world height (default 1600)\n"
+      << "  --population N    initial number of entities (default 40)\n"
+      << "  --spawn-every N   add an entity every N ticks, 0 for never "
+         "(default 60)\n"
+      << "  --ticks N         number of ticks to run (default 10000)\n"
+      << "  --report-every N  print progress every N ticks, and note when\n"
+      << "                    the entity pool grows\n"
+      << "  --threads N       worker threads (default: one per core)\n"
+      << "  --verbosity N     0 silent, 1 population changes, 2 births, deaths,\n"
+      << "                    meals and matings, 3 everything (default 3)\n"
+      << "  --events FILE     write events to FILE in binary, see\n"
+      << "                    technology-decode-log, instead of printing them\n"
+      << "  --quiet           same as --verbosity 0\n"
+      << "  --load FILE       continue from a snapshot instead of a new world;\n"
+      << "                    the seed and size options are then ignored\n"
+      << "  --save FILE       save a snapshot at the end of the run\n"
+      << "  --save-every N    also save it every N ticks\n"
+      << "  --series FILE     record population statistics to FILE, see\n"
+      << "                    technology-series; appends if FILE exists\n"
+      << "  --series-every N  record them every N ticks (default 1)\n"
+      << "  --frames PREFIX   draw the world every few ticks to PNG files\n"
+      << "                    PREFIX000000.png, PREFIX000001.png, ...\n"
+      << "  --frames-raw FILE or stream the frames as raw RGB24 to FILE, - for\n"
+      << "                    stdout (with --quiet or --events), e.g. for\n"
+      << "                    ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -i -\n"
+      << "  --frame-every N   draw a frame every N ticks (default 10)\n"
+      << "  --frame-scale S   pixels per unit of the world (default 1)\n";
+}
+
+bool parse_options(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--quiet") {
+      options.verbosity = EventLog::SILENT;
+      continue;
+    }
+    if (arg == "--help" || i + 1 >= argc)
+      return false;
+
+    const char *value = argv[++i];
+    if (arg == "--seed") {
+      options.seed = std::strtoul(value, NULL, 10);
+    } else if (arg == "--width") {
+      options.x_size = std::atof(value);
+    } else if (arg == "--height") {
+      options.y_size = std::atof(value);
+    } else if (arg == "--population") {
+      options.population = std::atoi(value);
+    } else if (arg == "--spawn-every") {
+      options.spawn_every = std::atol(value);
+    } else if (arg == "--ticks") {
+      options.ticks = std::atol(value);
+    } else if (arg == "--report-every") {
+      options.report_every = std::atol(value);
+    } else if (arg == "--threads") {
+      options.threads = std::atoi(value);
+    } else if (arg == "--verbosity") {
+      options.verbosity = std::atoi(value);
+    } else if (arg == "--events") {
+      options.events = value;
+    } else if (arg == "--load") {
+      options.load = value;
+    } else if (arg == "--save") {
+      options.save = value;
+    } else if (arg == "--save-every") {
+      options.save_every = std::atol(value);
+    } else if (arg == "--series") {
+      options.series = value;
+    } else if (arg == "--series-every") {
+      options.series_every = std::atol(value);
+    } else if (arg == "--frames") {
+      options.frames = value;
+    } else if (arg == "--frames-raw") {
+      options.frames_raw = value;
+    } else if (arg == "--frame-every") {
+      options.frame_every = std::atol(value);
+    } else if (arg == "--frame-scale") {
+      options.frame_scale = std::atof(value);
+    } else {
+      return false;
+    }
+  }
+
+  return options.x_size > 0 && options.y_size > 0 && options.population >= 0 &&
+         options.spawn_every >= 0 && options.ticks >= 0 && options.threads > 0 &&
+         options.save_every >= 0 && options.series_every > 0 &&
+         (options.save_every == 0 || !options.save.empty()) &&
+         options.frame_every > 0 && options.frame_scale > 0 &&
+         (options.frames.empty() || options.frames_raw.empty()) &&
+         (options.frames_raw != "-" ||
+          options.verbosity == EventLog::SILENT || !options.events.empty());
+}
+
+bool save(const State &state, const std::string &path) {
+  if (Snapshot::save(state, path))
+    return true;
+  std::cerr << "Can't save a snapshot to " << path << "." << std::endl;
+  return false;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+
+  if (!parse_options(argc, argv, options)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  using clock = std::chrono::steady_clock;
+
+  std::unique_ptr<State> state;
+  if (options.load.empty()) {
+    state.reset(new State(100.0, 0l, options.x_size, options.y_size,
+                          options.seed));
+  } else {
+    state.reset(Snapshot::load(options.load));
+    if (!state) {
+      std::cerr << "Can't load a snapshot from " << options.load << "."
+                << std::endl;
+      return 1;
+    }
+  }
+  state->set_num_threads(options.threads);
+
+  // Simulation events go to stdout, or to a binary file; progress and the
+  // summary go to stderr.
+  std::unique_ptr<EventLog> event_log;
+  if (options.verbosity > EventLog::SILENT) {
+    if (options.events.empty())
+      event_log.reset(new EventLog("-", EventLog::TEXT, options.verbosity));
+    else
+      event_log.reset(
+          new EventLog(options.events, EventLog::BINARY, options.verbosity));
+    if (!event_log->is_open()) {
+      std::cerr << "Can't write events to " << options.events << "."
+                << std::endl;
+      return 1;
+    }
+    state->set_event_log(event_log.get());
+  }
+
+  std::unique_ptr<Recorder> recorder;
+  if (!options.series.empty()) {
+    recorder.reset(new Recorder(options.series, options.series_every));
+    if (!recorder->is_open()) {
+      std::cerr << "Can't record a time series to " << options.series << "."
+                << std::endl;
+      return 1;
+    }
+    state->set_recorder(recorder.get());
+  }
+
+  std::unique_ptr<FrameWriter> frame_writer;
+  if (!options.frames.empty() || !options.frames_raw.empty()) {
+    bool png = !options.frames.empty();
+    frame_writer.reset(new FrameWriter(
+        png ? options.frames : options.frames_raw,
+        png ? FrameWriter::PNG : FrameWriter::RAW, state->x_size_value(),
+        state->y_size_value(), options.frame_scale, options.frame_every));
+    if (!frame_writer->is_open()) {
+      std::cerr << "Can't write frames to "
+                << (png ? options.frames : options.frames_raw) << "."
+                << std::endl;
+      return 1;
+    }
+    std::cerr << "Frames are " << frame_writer->width_value() << "x"
+              << frame_writer->height_value() << "." << std::endl;
+  }
+
+  if (options.load.empty()) {
+    for (int i = 0; i < options.population; i++) {
+      std::string name = std::to_string(i);
+      state->add_entity(name);
+    }
+  }
+
+  auto start = clock::now();
+
+  // Tick numbers carry on from a loaded snapshot, so that spawning and
+  // saving continue on the same schedule.
+  long first_tick = state->epoch_value() / State::tick_time + 1;
+  long last_tick = first_tick + options.ticks - 1;
+  size_t pool_capacity = state->entity_pool_value().capacity_value();
+
+  for (long n_ticks = first_tick; n_ticks <= last_tick; n_ticks++) {
+    if (options.spawn_every > 0 && n_ticks % options.spawn_every == 0) {
+      std::string new_name = "t" + std::to_string(n_ticks);
+      state->add_entity(new_name);
+    }
+
+    state->update();
+
+    if (frame_writer) {
+      frame_writer->capture(*state);
+      if (frame_writer->failed_value()) {
+        std::cerr << "Can't write a frame." << std::endl;
+        return 1;
+      }
+    }
+
+    const EntityPool &pool = state->entity_pool_value();
+    if (options.report_every > 0 && pool.capacity_value() != pool_capacity)
+      std::cerr << "Tick " << n_ticks << ": entity pool grew to "
+                << pool.capacity_value() << " entities in " << pool.num_slabs()
+                << " slabs." << std::endl;
+    pool_capacity = pool.capacity_value();
+
+    if (options.report_every > 0 && n_ticks % options.report_every == 0) {
+      std::chrono::duration<double> elapsed = clock::now() - start;
+      std::cerr << "Tick " << n_ticks << ", year " << state->date_str() << ": "
+                << state->num_entities() << " entities, "
+                << (n_ticks - first_tick + 1) / elapsed.count()
+                << " ticks/sec, entity pool " << pool.in_use_value() << "/"
+                << pool.capacity_value() << " full" << std::endl;
+    }
+
+    if (options.save_every > 0 && n_ticks % options.save_every == 0 &&
+        n_ticks != last_tick && !save(*state, options.save))
+      return 1;
+  }
+
+  if (!options.save.empty() && !save(*state, options.save))
+    return 1;
+
+  std::chrono::duration<double> elapsed = clock::now() - start;
+
+  std::cerr << "Ran " << options.ticks << " ticks in " << elapsed.count()
+            << " s (" << options.ticks / elapsed.count()
+            << " ticks/sec), seed " << state->seed_value() << ", "
+            << state->num_entities() << " entities at year "
+            << state->date_str() << "." << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,127 @@
+#include "intercept.h"
+#include <cmath>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// The solver is written once, below, over a type of lane: a double, or a
+// vector of them. Each lane type provides arithmetic, sqrt, abs, negation by
+// flipping the sign bit, and comparisons giving masks for select().
+
+inline double lane_abs(double a) { return std::fabs(a); }
+inline double lane_sqrt(double a) { return std::sqrt(a); }
+inline double lane_neg(double a) { return -a; }
+inline bool lane_gt(double a, double b) { return a > b; }
+inline bool lane_ge(double a, double b) { return a >= b; }
+inline double select(bool mask, double a, double b) { return mask ? a : b; }
+
+#if defined(__AVX__)
+
+struct Lanes {
+  __m256d v;
+  static constexpr int width = 4;
+  Lanes(double a) : v(_mm256_set1_pd(a)) {}
+  Lanes(__m256d v) : v(v) {}
+  static Lanes load(const double *p) { return _mm256_loadu_pd(p); }
+  void store(double *p) const { _mm256_storeu_pd(p, v); }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return _mm256_add_pd(a.v, b.v); }
+inline Lanes operator-(Lanes a, Lanes b) { return _mm256_sub_pd(a.v, b.v); }
+inline Lanes operator*(Lanes a, Lanes b) { return _mm256_mul_pd(a.v, b.v); }
+inline Lanes operator/(Lanes a, Lanes b) { return _mm256_div_pd(a.v, b.v); }
+inline Lanes lane_sqrt(Lanes a) { return _mm256_sqrt_pd(a.v); }
+inline Lanes lane_abs(Lanes a) {
+  return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v);
+}
+inline Lanes lane_neg(Lanes a) {
+  return _mm256_xor_pd(_mm256_set1_pd(-0.0), a.v);
+}
+inline Lanes lane_gt(Lanes a, Lanes b) {
+  return _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ);
+}
+inline Lanes lane_ge(Lanes a, Lanes b) {
+  return _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ);
+}
+inline Lanes select(Lanes mask, Lanes a, Lanes b) {
+  return _mm256_blendv_pd(b.v, a.v, mask.v);
+}
+
+#elif defined(__SSE2__)
+
+struct Lanes {
+  __m128d v;
+  static constexpr int width = 2;
+  Lanes(double a) : v(_mm_set1_pd(a)) {}
+  Lanes(__m128d v) : v(v) {}
+  static Lanes load(const double *p) { return _mm_loadu_pd(p); }
+  void store(double *p) const { _mm_storeu_pd(p, v); }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return _mm_add_pd(a.v, b.v); }
+inline Lanes operator-(Lanes a, Lanes b) { return _mm_sub_pd(a.v, b.v); }
+inline Lanes operator*(Lanes a, Lanes b) { return _mm_mul_pd(a.v, b.v); }
+inline Lanes operator/(Lanes a, Lanes b) { return _mm_div_pd(a.v, b.v); }
+inline Lanes lane_sqrt(Lanes a) { return _mm_sqrt_pd(a.v); }
+inline Lanes lane_abs(Lanes a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a.v); }
+inline Lanes lane_neg(Lanes a) { return _mm_xor_pd(_mm_set1_pd(-0.0), a.v); }
+inline Lanes lane_gt(Lanes a, Lanes b) { return _mm_cmpgt_pd(a.v, b.v); }
+inline Lanes lane_ge(Lanes a, Lanes b) { return _mm_cmpge_pd(a.v, b.v); }
+inline Lanes select(Lanes mask, Lanes a, Lanes b) {
+  return _mm_or_pd(_mm_and_pd(mask.v, a.v), _mm_andnot_pd(mask.v, b.v));
+}
+
+#endif
+
+// Comparisons with NaN are false, so NaN roots fall through to the next
+// choice without a test of their own.
+template <typename V>
+V solve(V x, V y, V sh, V x_size, V y_size, V Ptx, V Pty, V Vtx, V Vty) {
+  // Adjust based on periodic boundaries.
+  V dx = x - Ptx;
+  V dy = y - Pty;
+  V wrapped_x = x_size - lane_abs(dx);
+  V wrapped_y = y_size - lane_abs(dy);
+  dx = select(lane_gt(lane_abs(dx), wrapped_x), wrapped_x, dx);
+  dy = select(lane_gt(lane_abs(dy), wrapped_y), wrapped_y, dy);
+  V Phx = dx + Ptx;
+  V Phy = dy + Pty;
+
+  V a = (Vtx * Vtx) + (Vty * Vty) - (sh * sh);
+  V b = V(2.0) * ((Ptx * Vtx) + (Pty * Vty) - (Phx * Vtx) - (Phy * Vty));
+  V c = (Ptx * Ptx) + (Pty * Pty) + (Phx * Phx) + (Phy * Phy) -
+        (V(2.0) * Phx * Ptx) - (V(2.0) * Phy * Pty);
+
+  V root = lane_sqrt((b * b) - (V(4.0) * a * c));
+  V t1 = (lane_neg(b) + root) / (V(2.0) * a);
+  V t2 = (lane_neg(b) - root) / (V(2.0) * a);
+
+  V zero(0.0);
+  return select(lane_gt(t1, zero), t1,
+                select(lane_ge(t2, zero), t2, zero));
+}
+
+} // namespace
+
+double intercept_time(const Pursuer &p, double tx, double ty, double vx,
+                      double vy) {
+  return solve<double>(p.x, p.y, p.speed, p.x_size, p.y_size, tx, ty, vx, vy);
+}
+
+void intercept_times(const Pursuer &p, int n, const double *tx,
+                     const double *ty, const double *vx, const double *vy,
+                     double *times) {
+  int k = 0;
+#if defined(__AVX__) || defined(__SSE2__)
+  Lanes x(p.x), y(p.y), speed(p.speed), x_size(p.x_size), y_size(p.y_size);
+  for (; k + Lanes::width <= n; k += Lanes::width)
+    solve<Lanes>(x, y, speed, x_size, y_size, Lanes::load(tx + k),
+                 Lanes::load(ty + k), Lanes::load(vx + k), Lanes::load(vy + k))
+        .store(times + k);
+#endif
+  for (; k < n; k++)
+    times[k] = intercept_time(p, tx[k], ty[k], vx[k], vy[k]);
+}
@@ -0,0 +1,25 @@
+#ifndef INTERCEPT_H
+#define INTERCEPT_H
+
+// Who is giving chase: where from, in a world of what size, and how fast.
+struct Pursuer {
+  double x, y, speed, x_size, y_size;
+};
+
+// Solves the pursuit quadratic for the time a pursuer takes to catch a
+// target at (tx, ty) moving (vx, vy) a unit of time, going the short way
+// round the world's periodic boundaries. Gives the root (-b + sqrt(d)) / 2a
+// if it's positive, or else the other if that's not negative, or else 0,
+// which includes when there's no real root.
+double intercept_time(const Pursuer &, double, double, double, double);
+
+// The same for n targets given column by column, several at a time in SIMD
+// lanes where the build has them (AVX or SSE2), and one at a time for the
+// rest. The results are bit for bit those of intercept_time(): the lanes do
+// the same operations in the same order, and pick the root by masking
+// rather than by branching. That needs the compiler not to fuse them into
+// FMAs, so intercept.cpp is built with -ffp-contract=off.
+void intercept_times(const Pursuer &, int, const double *, const double *,
+                     const double *, const double *, double *);
+
+#endif
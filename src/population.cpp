@@ -0,0 +1,146 @@
+#include "entity.h"
+#include "population.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+int Population::size() const { return x.size(); }
+
+// Appends a zeroed row and returns its index.
+int Population::push_back() {
+  x.push_back(0.0);
+  y.push_back(0.0);
+  px.push_back(0.0);
+  py.push_back(0.0);
+  energy.push_back(0.0);
+  mood.push_back(0.0);
+  age.push_back(0.0);
+  conception_mass.push_back(0.0);
+  epoch_of_death.push_back(0);
+  flags.push_back(0);
+  genome.push_back(0);
+  cell.push_back(-1);
+  derived_mass.push_back(0.0);
+  derived_max_energy.push_back(0.0);
+  derived_terminal_speed.push_back(0.0);
+  return x.size() - 1;
+}
+
+template <typename T> static void swap_remove_column(std::vector<T> &c, int i) {
+  c[i] = c.back();
+  c.pop_back();
+}
+
+void Population::swap_remove(int i) {
+  swap_remove_column(x, i);
+  swap_remove_column(y, i);
+  swap_remove_column(px, i);
+  swap_remove_column(py, i);
+  swap_remove_column(energy, i);
+  swap_remove_column(mood, i);
+  swap_remove_column(age, i);
+  swap_remove_column(conception_mass, i);
+  swap_remove_column(epoch_of_death, i);
+  swap_remove_column(flags, i);
+  swap_remove_column(genome, i);
+  swap_remove_column(cell, i);
+  swap_remove_column(derived_mass, i);
+  swap_remove_column(derived_max_energy, i);
+  swap_remove_column(derived_terminal_speed, i);
+}
+
+void Population::clear() {
+  x.clear();
+  y.clear();
+  px.clear();
+  py.clear();
+  energy.clear();
+  mood.clear();
+  age.clear();
+  conception_mass.clear();
+  epoch_of_death.clear();
+  flags.clear();
+  genome.clear();
+  cell.clear();
+  derived_mass.clear();
+  derived_max_energy.clear();
+  derived_terminal_speed.clear();
+}
+
+int Population::gene(int i, int trait) const {
+  return (genome[i] >> trait) & 1;
+}
+
+static double mass_of(const Population &p, int i) {
+  return p.conception_mass[i] + std::log(1.0 + p.age[i] / Entity::year);
+}
+
+static double max_energy_of(const Population &p, int i, double mass) {
+  return p.conception_mass[i] +
+         mass * Entity::max_energy_coefficient * p.age[i] / Entity::year;
+}
+
+// Assumes creatures are all same density.
+static double terminal_speed_of(double mass) {
+  return Entity::terminal_speed_coefficient * pow(mass, 1.0 / 6.0);
+}
+
+// Brings row i's derived quantities up to date; called after anything that
+// changes its age, conception mass or genome.
+void Population::derive(int i) {
+  double mass = mass_of(*this, i);
+  derived_mass[i] = mass;
+  derived_max_energy[i] = max_energy_of(*this, i, mass);
+  derived_terminal_speed[i] = terminal_speed_of(mass);
+}
+
+// Fails if row i's derived quantities are out of date. Every read checks
+// this when built with -DCHECK_DERIVED.
+void Population::check_derived(int i) const {
+  double mass = mass_of(*this, i);
+  assert(derived_mass[i] == mass);
+  assert(derived_max_energy[i] == max_energy_of(*this, i, mass));
+  assert(derived_terminal_speed[i] == terminal_speed_of(mass));
+  (void)mass;
+}
+
+double Population::current_mass(int i) const {
+#ifdef CHECK_DERIVED
+  check_derived(i);
+#endif
+  return derived_mass[i];
+}
+
+double Population::max_energy(int i) const {
+#ifdef CHECK_DERIVED
+  check_derived(i);
+#endif
+  return derived_max_energy[i];
+}
+
+double Population::terminal_speed(int i) const {
+#ifdef CHECK_DERIVED
+  check_derived(i);
+#endif
+  return derived_terminal_speed[i];
+}
+
+long Population::impotence_age(int i) const {
+  return Entity::impotence_age_coefficient *
+         (gene<Trait::stationary>(i) ? 10 : 1);
+}
+
+long Population::birth_age(int i) const {
+  return gene<Trait::gestates>(i)
+             ? Entity::birth_age_coefficient * impotence_age(i)
+             : 0;
+}
+
+double Population::prob_death(int i) const {
+  return std::min(1.0, Entity::death_probability_coefficient * age[i] /
+                           impotence_age(i));
+}
+
+void Population::adjust_energy(int i, double adjustment) {
+  energy[i] = std::min(max_energy(i), std::max(0.0, energy[i] + adjustment));
+}
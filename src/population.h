@@ -0,0 +1,43 @@
+#ifndef POPULATION_H
+#define POPULATION_H
+
+#include "traits.h"
+#include <vector>
+
+// The per-entity quantities touched every tick, stored column-wise so the
+// per-tick phases are linear sweeps. Row i belongs to the entity at dense
+// index i of State's slot map; both are swap-removed together.
+struct Population {
+  enum Flags : unsigned char { ALIVE = 1, WILL_DIE = 2, HOSTED = 4 };
+
+  std::vector<double> x, y, px, py;
+  std::vector<double> energy, mood, age, conception_mass;
+  std::vector<long> epoch_of_death;
+  std::vector<unsigned char> flags;
+  std::vector<Genome> genome;
+  std::vector<int> cell;
+  // Functions of age, conception mass and genome, worked out by derive()
+  // whenever one of those changes rather than on every use.
+  std::vector<double> derived_mass, derived_max_energy, derived_terminal_speed;
+
+  int size() const;
+  int push_back();
+  void swap_remove(int);
+  void clear();
+
+  int gene(int, int) const;
+  template <Trait T> int gene(int i) const {
+    return (genome[i] & trait_bit(T)) != 0;
+  }
+  void derive(int);
+  void check_derived(int) const;
+  double current_mass(int) const;
+  double max_energy(int) const;
+  double terminal_speed(int) const;
+  long impotence_age(int) const;
+  long birth_age(int) const;
+  double prob_death(int) const;
+  void adjust_energy(int, double);
+};
+
+#endif
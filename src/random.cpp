@@ -0,0 +1,55 @@
+#include "random.h"
+
+static std::uint64_t mix(std::uint64_t z) {
+  // splitmix64 finaliser.
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+RandomStream::RandomStream(unsigned long seed, long entity, long tick,
+                           Site site, long other)
+    : used(4) {
+  std::uint64_t k = mix(seed + 0x9e3779b97f4a7c15ull);
+  k = mix(k ^ std::uint64_t(entity));
+  k = mix(k ^ std::uint64_t(other));
+  key[0] = std::uint32_t(k);
+  key[1] = std::uint32_t(k >> 32);
+
+  counter[0] = 0;
+  counter[1] = std::uint32_t(site);
+  counter[2] = std::uint32_t(std::uint64_t(tick));
+  counter[3] = std::uint32_t(std::uint64_t(tick) >> 32);
+}
+
+void RandomStream::generate_block() {
+  constexpr std::uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+  constexpr std::uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+  std::uint32_t c[4] = {counter[0], counter[1], counter[2], counter[3]};
+  std::uint32_t k0 = key[0], k1 = key[1];
+
+  for (int round = 0; round < 10; round++) {
+    std::uint64_t p0 = std::uint64_t(M0) * c[0];
+    std::uint64_t p1 = std::uint64_t(M1) * c[2];
+    std::uint32_t hi0 = p0 >> 32, lo0 = std::uint32_t(p0);
+    std::uint32_t hi1 = p1 >> 32, lo1 = std::uint32_t(p1);
+    c[0] = hi1 ^ c[1] ^ k0;
+    c[1] = lo1;
+    c[2] = hi0 ^ c[3] ^ k1;
+    c[3] = lo0;
+    k0 += W0;
+    k1 += W1;
+  }
+
+  for (int i = 0; i < 4; i++)
+    block[i] = c[i];
+  counter[0]++;
+  used = 0;
+}
+
+RandomStream::result_type RandomStream::operator()() {
+  if (used == 4)
+    generate_block();
+  return block[used++];
+}
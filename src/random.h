@@ -0,0 +1,46 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+#include <limits>
+
+// The places in the simulation that draw random numbers. Each one gets its
+// own stream, so adding draws to one site never shifts another.
+enum class Site : std::uint32_t {
+  spawn,
+  birth,
+  move,
+  mate,
+  mate_target,
+  death,
+  gametophytes
+};
+
+// A counter-based generator (Philox4x32-10). Every stream is a pure function
+// of (world seed, entity id, tick, call site, other entity id), so results
+// don't depend on the order in which entities are evaluated or on which
+// thread evaluates them. Satisfies UniformRandomBitGenerator, so the std
+// distributions can draw from it.
+class RandomStream {
+
+private:
+  std::uint32_t key[2];
+  std::uint32_t counter[4];
+  std::uint32_t block[4];
+  int used;
+
+  void generate_block();
+
+public:
+  typedef std::uint32_t result_type;
+
+  RandomStream(unsigned long, long, long, Site, long = -1);
+  result_type operator()();
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+};
+
+#endif
@@ -0,0 +1,264 @@
+#include "entity.h"
+#include "recorder.h"
+#include "state.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unistd.h>
+
+namespace {
+
+const char zeros[8] = {};
+
+size_t padding(size_t bytes) { return (8 - bytes % 8) % 8; }
+
+// The header is the magic, version, column count and each name prefixed by
+// its length, padded to a multiple of 8 bytes.
+bool write_header(FILE *file, const std::vector<std::string> &names) {
+  uint32_t fields[2] = {Recorder::version, uint32_t(names.size())};
+  size_t bytes = sizeof(Recorder::magic) + sizeof(fields);
+  if (std::fwrite(Recorder::magic, sizeof(Recorder::magic), 1, file) != 1 ||
+      std::fwrite(fields, sizeof(fields), 1, file) != 1)
+    return false;
+  for (auto &name : names) {
+    uint32_t length = name.size();
+    if (std::fwrite(&length, sizeof(length), 1, file) != 1 ||
+        std::fwrite(name.data(), 1, length, file) != length)
+      return false;
+    bytes += sizeof(length) + length;
+  }
+  return std::fwrite(zeros, 1, padding(bytes), file) == padding(bytes);
+}
+
+bool read_header(FILE *file, std::vector<std::string> &names) {
+  char m[sizeof(Recorder::magic)];
+  uint32_t fields[2];
+  if (std::fread(m, sizeof(m), 1, file) != 1 ||
+      std::memcmp(m, Recorder::magic, sizeof(m)) != 0 ||
+      std::fread(fields, sizeof(fields), 1, file) != 1 ||
+      fields[0] != Recorder::version)
+    return false;
+
+  size_t bytes = sizeof(m) + sizeof(fields);
+  names.clear();
+  for (uint32_t c = 0; c < fields[1]; c++) {
+    uint32_t length;
+    if (std::fread(&length, sizeof(length), 1, file) != 1 || length > 1024)
+      return false;
+    std::string name(length, ' ');
+    if (std::fread(&name[0], 1, length, file) != length)
+      return false;
+    names.push_back(name);
+    bytes += sizeof(length) + length;
+  }
+  return std::fseek(file, padding(bytes), SEEK_CUR) == 0;
+}
+
+} // namespace
+
+Recorder::Recorder(const std::string &path, long every)
+    : file(NULL), every(std::max(every, 1l)), rows(0),
+      last_counts(int(Event::count), 0),
+      last_write(std::chrono::steady_clock::now()) {
+  block.resize(columns().size() * block_rows);
+  if (!open(path) && file != NULL) {
+    std::fclose(file);
+    file = NULL;
+  }
+}
+
+Recorder::~Recorder() {
+  if (file != NULL) {
+    flush();
+    std::fclose(file);
+  }
+}
+
+// Appends to an existing file with the same columns, dropping any block a
+// crash left incomplete, or else starts a new one.
+bool Recorder::open(const std::string &path) {
+  std::vector<std::string> names = columns();
+
+  file = std::fopen(path.c_str(), "r+b");
+  if (file != NULL) {
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::rewind(file);
+    if (size > 0) {
+      std::vector<std::string> existing;
+      if (!read_header(file, existing) || existing != names)
+        return false;
+
+      long end = std::ftell(file);
+      uint32_t fields[2];
+      while (end + long(sizeof(fields)) <= size &&
+             std::fread(fields, sizeof(fields), 1, file) == 1 &&
+             fields[0] == block_magic) {
+        long next = end + sizeof(fields) +
+                    long(fields[1]) * names.size() * sizeof(double);
+        if (next > size)
+          break;
+        end = next;
+        std::fseek(file, end, SEEK_SET);
+      }
+      std::fflush(file);
+      return ftruncate(fileno(file), end) == 0 &&
+             std::fseek(file, end, SEEK_SET) == 0;
+    }
+    std::fclose(file);
+  }
+
+  file = std::fopen(path.c_str(), "wb");
+  return file != NULL && write_header(file, names) && std::fflush(file) == 0;
+}
+
+bool Recorder::is_open() const { return file != NULL; }
+
+// Births are of free-living offspring: those that leave a host, logged as
+// born, and those mate() puts straight into the world, which are the
+// conceptions (every mating) that aren't impregnations.
+std::vector<std::string> Recorder::columns() {
+  std::vector<std::string> names = {"epoch", "entities", "living", "corpses",
+                                    "hosted"};
+  for (auto &trait : Entity::all_traits)
+    names.push_back("freq_" + trait);
+  for (auto name : {"mean_energy", "mean_mass", "mean_age", "births",
+                    "conceptions", "meals", "deaths_starved", "deaths_natural",
+                    "deaths_eaten", "deaths_with_host"})
+    names.push_back(name);
+  return names;
+}
+
+// Called by State after every tick; adds a row every `every` ticks. Means
+// and trait frequencies are over living entities, event counts over the
+// ticks since the previous row.
+void Recorder::record(const State &state) {
+  long tick = state.epoch_value() / State::tick_time;
+  if (file == NULL || tick % every != 0)
+    return;
+
+  const Population &p = state.population_value();
+  long living = 0, hosted = 0;
+  long trait_counts[num_traits] = {};
+  double energy = 0.0, mass = 0.0, age = 0.0;
+
+  for (int i = 0; i < p.size(); i++) {
+    if (!(p.flags[i] & Population::ALIVE))
+      continue;
+    living++;
+    hosted += (p.flags[i] & Population::HOSTED) != 0;
+    for (int t = 0; t < num_traits; t++)
+      trait_counts[t] += p.gene(i, t);
+    energy += p.energy[i];
+    mass += p.current_mass(i);
+    age += p.age[i];
+  }
+
+  long counts[int(Event::count)];
+  for (int k = 0; k < int(Event::count); k++) {
+    long total = state.event_count(Event(k));
+    counts[k] = total - last_counts[k];
+    last_counts[k] = total;
+  }
+  auto count = [&](Event kind) { return double(counts[int(kind)]); };
+
+  double n = living > 0 ? living : std::numeric_limits<double>::quiet_NaN();
+  std::vector<double> values = {double(state.epoch_value()),
+                                double(p.size()), double(living),
+                                double(p.size() - living), double(hosted)};
+  for (int t = 0; t < num_traits; t++)
+    values.push_back(trait_counts[t] / n);
+  values.insert(values.end(),
+                {energy / n, mass / n, age / n,
+                 count(Event::born) + count(Event::mated) -
+                     count(Event::impregnated),
+                 count(Event::mated), count(Event::ate),
+                 count(Event::starved), count(Event::died),
+                 // Every other kill is of an entity marked as eaten.
+                 count(Event::killed) - count(Event::starved) -
+                     count(Event::died) - count(Event::parasite_killed),
+                 count(Event::parasite_killed)});
+
+  for (size_t c = 0; c < values.size(); c++)
+    block[c * block_rows + rows] = values[c];
+  rows++;
+
+  std::chrono::duration<double> pending =
+      std::chrono::steady_clock::now() - last_write;
+  if (rows == block_rows || pending.count() > max_pending_seconds)
+    write_block();
+}
+
+// Writes out any pending rows.
+void Recorder::flush() {
+  if (file != NULL && rows > 0)
+    write_block();
+}
+
+void Recorder::write_block() {
+  int num_columns = block.size() / block_rows;
+  uint32_t fields[2] = {block_magic, uint32_t(rows)};
+  std::fwrite(fields, sizeof(fields), 1, file);
+  for (int c = 0; c < num_columns; c++)
+    std::fwrite(&block[c * block_rows], sizeof(double), rows, file);
+  std::fflush(file);
+
+  rows = 0;
+  last_write = std::chrono::steady_clock::now();
+}
+
+SeriesReader::SeriesReader(const std::string &path) : rows(0), row(0) {
+  file = std::fopen(path.c_str(), "rb");
+  if (file != NULL && !read_header(file, names)) {
+    std::fclose(file);
+    file = NULL;
+  }
+}
+
+SeriesReader::~SeriesReader() {
+  if (file != NULL)
+    std::fclose(file);
+}
+
+bool SeriesReader::is_open() const { return file != NULL; }
+
+const std::vector<std::string> &SeriesReader::columns() const {
+  return names;
+}
+
+// Reads the next whole block, or leaves the file where it was if the block
+// isn't all there yet.
+bool SeriesReader::read_block() {
+  long start = std::ftell(file);
+  uint32_t fields[2];
+  bool ok = std::fread(fields, sizeof(fields), 1, file) == 1 &&
+            fields[0] == Recorder::block_magic;
+  if (ok) {
+    block.resize(size_t(fields[1]) * names.size());
+    ok = std::fread(block.data(), sizeof(double), block.size(), file) ==
+         block.size();
+  }
+  if (!ok) {
+    std::clearerr(file);
+    std::fseek(file, start, SEEK_SET);
+    return false;
+  }
+  rows = fields[1];
+  row = 0;
+  return true;
+}
+
+bool SeriesReader::next(std::vector<double> &values) {
+  if (file == NULL)
+    return false;
+  while (row >= rows) {
+    if (!read_block())
+      return false;
+  }
+
+  values.resize(names.size());
+  for (size_t c = 0; c < names.size(); c++)
+    values[c] = block[c * rows + row];
+  row++;
+  return true;
+}
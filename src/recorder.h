@@ -0,0 +1,69 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class State;
+
+// Records population statistics every few ticks to a columnar file. The
+// file is a header naming the columns followed by blocks of rows, stored
+// column by column; a block is written whole once it fills up or has been
+// pending for a while, so memory stays bounded and readers (SeriesReader)
+// can follow the file while the run continues. Opening an existing file with
+// the same columns appends to it.
+class Recorder {
+
+public:
+  static constexpr char magic[8] = {'T', 'E', 'C', 'H', 'S', 'E', 'R', 'I'};
+  static constexpr uint32_t version = 1;
+  static constexpr uint32_t block_magic = 0x4b4c4231;
+
+private:
+  static constexpr int block_rows = 256;
+  static constexpr double max_pending_seconds = 1.0;
+
+  FILE *file;
+  long every;
+  std::vector<double> block;
+  int rows;
+  std::vector<long> last_counts;
+  std::chrono::steady_clock::time_point last_write;
+
+  bool open(const std::string &);
+  void write_block();
+
+public:
+  Recorder(const std::string &, long = 1);
+  ~Recorder();
+  bool is_open() const;
+  void record(const State &);
+  void flush();
+  static std::vector<std::string> columns();
+};
+
+// Reads the rows of a file written by Recorder, one at a time. Reaching the
+// end of the file isn't final: once the recorder has written more blocks,
+// next() picks them up.
+class SeriesReader {
+
+private:
+  FILE *file;
+  std::vector<std::string> names;
+  std::vector<double> block;
+  int rows, row;
+
+  bool read_block();
+
+public:
+  SeriesReader(const std::string &);
+  ~SeriesReader();
+  bool is_open() const;
+  const std::vector<std::string> &columns() const;
+  bool next(std::vector<double> &);
+};
+
+#endif
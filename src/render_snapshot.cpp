@@ -0,0 +1,97 @@
+#include "constants.h"
+#include "entity.h"
+#include "render_snapshot.h"
+#include "state.h"
+#include <algorithm>
+#include <cstdio>
+
+RenderSnapshot::RenderSnapshot() : epoch(-1), x_size(0.0), y_size(0.0) {}
+
+// Young entities are blue and old ones purple; adults go from red to green
+// with mood. Corpses fade as they decay.
+void RenderSnapshot::capture(const State &state) {
+  epoch = state.epoch_value();
+  date = state.date_str();
+  x_size = state.x_size_value();
+  y_size = state.y_size_value();
+  time = std::chrono::steady_clock::now();
+
+  const std::vector<Entity *> &all = state.entities_value();
+  entities.resize(all.size());
+
+  double cell = std::max({density_cell, x_size / max_density_cells,
+                          y_size / max_density_cells});
+  density.reset(std::ceil(x_size / cell), std::ceil(y_size / cell), 0.0, 0.0,
+                cell);
+
+  for (size_t k = 0; k < all.size(); k++) {
+    const Entity *i = all[k];
+    RenderEntity &r = entities[k];
+
+    double death_scale =
+        (i->alive_value()
+             ? 1.0
+             : (0.9 *
+                    std::max(Entity::corpse_lifetime - i->time_since_death(),
+                             0.0) /
+                    Entity::corpse_lifetime +
+                0.1));
+    uint8_t shade = std::floor(death_scale * 255);
+    if (i->age_since_birth() < Entity::mating_age) {
+      r.rgba[0] = 0;
+      r.rgba[1] = 0;
+      r.rgba[2] = shade;
+    } else if (i->age_since_birth() > i->impotence_age()) {
+      r.rgba[0] = shade;
+      r.rgba[1] = 0;
+      r.rgba[2] = shade;
+    } else {
+      double mood_scale = 0.5 * (1.0 + 2.0 / PI * std::atan(i->mood_value()));
+      r.rgba[0] = std::floor(255 * death_scale * (1.0 - mood_scale));
+      r.rgba[1] = std::floor(255 * death_scale * mood_scale);
+      r.rgba[2] = 0;
+    }
+    r.rgba[3] = 255;
+
+    r.x = i->x_value();
+    r.y = i->y_value();
+    r.px = i->px_value();
+    r.py = i->py_value();
+    r.radius = std::max(i->current_mass(), 1.0);
+    r.ring = i->host_value() == NULL && i->parasite_count() == 1;
+
+    int n = 0;
+    if (i->host_value() == NULL) {
+      if (!i->alive_value()) {
+        r.status[n++] = 'd';
+      } else {
+        if (i->is_hungry())
+          r.status[n++] = 'h';
+        if (i->will_mate())
+          r.status[n++] = 'm';
+        if (i->parasite_count())
+          n += std::snprintf(r.status + n, sizeof(r.status) - n, "%d",
+                             i->parasite_count());
+      }
+    }
+    r.status[std::min<size_t>(n, sizeof(r.status) - 1)] = '\0';
+
+    density.add(r.x, r.y, r.rgba);
+  }
+}
+
+SnapshotExchange::SnapshotExchange() : ready(0), writing(1), reading(2) {}
+
+// The buffer to capture the next snapshot into.
+RenderSnapshot &SnapshotExchange::back() { return buffers[writing]; }
+
+void SnapshotExchange::publish() {
+  writing = ready.exchange(writing | fresh, std::memory_order_acq_rel) & 3;
+}
+
+// The newest published snapshot, which stays valid until the next call.
+const RenderSnapshot &SnapshotExchange::latest() {
+  if (ready.load(std::memory_order_relaxed) & fresh)
+    reading = ready.exchange(reading, std::memory_order_acq_rel) & 3;
+  return buffers[reading];
+}
@@ -0,0 +1,64 @@
+#ifndef RENDER_SNAPSHOT_H
+#define RENDER_SNAPSHOT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "density_grid.h"
+
+class State;
+
+// How to draw one entity: where it is and was a tick ago (x - px, y - py),
+// its radius and colour, whether it gets a parasite ring, and its status
+// label: "d" if dead, else "h" if hungry, "m" if it will mate and its
+// number of parasites.
+struct RenderEntity {
+  float x, y, px, py, radius;
+  uint8_t rgba[4];
+  bool ring;
+  char status[8];
+};
+
+// Everything the renderer needs from the world after a tick, copied out so
+// that drawing never touches State. The density grid over the world, built
+// as the entities are copied, lets crowds be drawn without going through
+// them again.
+struct RenderSnapshot {
+  static constexpr double density_cell = 8.0;
+  static constexpr int max_density_cells = 512;
+
+  long epoch;
+  std::string date;
+  double x_size, y_size;
+  std::chrono::steady_clock::time_point time;
+  std::vector<RenderEntity> entities;
+  DensityGrid density;
+
+  RenderSnapshot();
+  void capture(const State &);
+};
+
+// Hands snapshots from the simulation thread to the renderer without either
+// ever waiting for the other. Of three buffers, the simulation writes one
+// and the renderer reads another; publishing swaps the written one with the
+// third, latest() swaps the read one with it if it's newer.
+class SnapshotExchange {
+
+private:
+  static constexpr int fresh = 4;
+
+  RenderSnapshot buffers[3];
+  std::atomic<int> ready;
+  int writing, reading;
+
+public:
+  SnapshotExchange();
+  RenderSnapshot &back();
+  void publish();
+  const RenderSnapshot &latest();
+};
+
+#endif
@@ -0,0 +1,58 @@
+// Prints a population time series written by Recorder as CSV, optionally
+// following the file as the run that writes it continues.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "recorder.h"
+
+int main(int argc, char **argv) {
+  bool follow = false, ok = true;
+  const char *path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--follow") == 0)
+      follow = true;
+    else if (path == NULL)
+      path = argv[i];
+    else
+      ok = false;
+  }
+
+  if (path == NULL || !ok) {
+    std::cerr << "Usage: " << argv[0] << " [--follow] SERIES\n"
+              << "  --follow  keep printing rows as they are recorded\n";
+    return 1;
+  }
+
+  SeriesReader reader(path);
+  if (!reader.is_open()) {
+    std::cerr << "Can't read a time series from " << path << "." << std::endl;
+    return 1;
+  }
+
+  const std::vector<std::string> &columns = reader.columns();
+  for (size_t c = 0; c < columns.size(); c++)
+    std::printf("%s%s", c > 0 ? "," : "", columns[c].c_str());
+  std::printf("\n");
+
+  std::vector<double> row;
+  while (true) {
+    while (reader.next(row)) {
+      for (size_t c = 0; c < row.size(); c++)
+        std::printf("%s%.10g", c > 0 ? "," : "", row[c]);
+      std::printf("\n");
+    }
+    if (!follow)
+      break;
+    std::fflush(stdout);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+
+  return 0;
+}
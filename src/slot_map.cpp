@@ -0,0 +1,91 @@
+#include "entity.h"
+#include "slot_map.h"
+#include <cassert>
+
+// Slot 0 is reserved so that the default Handle is never valid.
+template <class T> SlotMap<T>::SlotMap() : slots(1, Slot{0, 1}) {}
+
+template <class T> Handle SlotMap<T>::insert(T value) {
+  unsigned slot;
+  if (free_slots.empty()) {
+    slot = slots.size();
+    slots.push_back(Slot{0, 1});
+  } else {
+    slot = free_slots.back();
+    free_slots.pop_back();
+  }
+
+  slots[slot].dense = dense.size();
+  dense.push_back(value);
+  dense_slots.push_back(slot);
+
+  return Handle{slot, slots[slot].generation};
+}
+
+template <class T> void SlotMap<T>::erase(Handle handle) {
+  assert(contains(handle));
+  Slot &slot = slots[handle.slot];
+
+  // Move the last element into the hole.
+  unsigned last_slot = dense_slots.back();
+  dense[slot.dense] = dense.back();
+  dense_slots[slot.dense] = last_slot;
+  slots[last_slot].dense = slot.dense;
+  dense.pop_back();
+  dense_slots.pop_back();
+
+  slot.generation++;
+  free_slots.push_back(handle.slot);
+}
+
+template <class T> bool SlotMap<T>::contains(Handle handle) const {
+  return handle.slot > 0 && handle.slot < slots.size() &&
+         slots[handle.slot].generation == handle.generation;
+}
+
+template <class T> T SlotMap<T>::get(Handle handle) const {
+  return contains(handle) ? dense[slots[handle.slot].dense] : T();
+}
+
+template <class T> int SlotMap<T>::dense_index(Handle handle) const {
+  return contains(handle) ? int(slots[handle.slot].dense) : -1;
+}
+
+template <class T> Handle SlotMap<T>::handle(int index) const {
+  unsigned slot = dense_slots[index];
+  return Handle{slot, slots[slot].generation};
+}
+
+template <class T> int SlotMap<T>::size() const { return dense.size(); }
+
+template <class T> void SlotMap<T>::clear() {
+  for (unsigned i = 0; i < dense.size(); i++) {
+    slots[dense_slots[i]].generation++;
+    free_slots.push_back(dense_slots[i]);
+  }
+  dense.clear();
+  dense_slots.clear();
+}
+
+template <class T> T &SlotMap<T>::operator[](int index) {
+  return dense[index];
+}
+
+template <class T> const T &SlotMap<T>::operator[](int index) const {
+  return dense[index];
+}
+
+template <class T> const std::vector<T> &SlotMap<T>::dense_value() const {
+  return dense;
+}
+
+template <class T> typename std::vector<T>::iterator SlotMap<T>::begin() {
+  return dense.begin();
+}
+
+template <class T> typename std::vector<T>::iterator SlotMap<T>::end() {
+  return dense.end();
+}
+
+// Instantiate the particular template variants we want.
+template class SlotMap<Entity *>;
@@ -0,0 +1,51 @@
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <vector>
+
+// A stable reference into a SlotMap. The generation is bumped every time a
+// slot is freed, so handles to erased elements are detected as stale. The
+// default handle never refers to anything.
+struct Handle {
+  unsigned slot = 0;
+  unsigned generation = 0;
+
+  bool operator==(const Handle &other) const {
+    return slot == other.slot && generation == other.generation;
+  }
+  bool operator!=(const Handle &other) const { return !(*this == other); }
+};
+
+// Elements are kept densely packed for iteration; erasing moves the last
+// element into the hole, so dense indices are not stable but handles are.
+template <class T> class SlotMap {
+
+private:
+  struct Slot {
+    unsigned dense;
+    unsigned generation;
+  };
+
+  std::vector<T> dense;
+  std::vector<unsigned> dense_slots;
+  std::vector<Slot> slots;
+  std::vector<unsigned> free_slots;
+
+public:
+  SlotMap();
+  Handle insert(T);
+  void erase(Handle);
+  bool contains(Handle) const;
+  T get(Handle) const;
+  int dense_index(Handle) const;
+  Handle handle(int) const;
+  int size() const;
+  void clear();
+  T &operator[](int);
+  const T &operator[](int) const;
+  const std::vector<T> &dense_value() const;
+  typename std::vector<T>::iterator begin();
+  typename std::vector<T>::iterator end();
+};
+
+#endif
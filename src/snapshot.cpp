@@ -0,0 +1,346 @@
+#include "entity.h"
+#include "snapshot.h"
+#include "state.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+size_t padding(size_t bytes) { return (8 - bytes % 8) % 8; }
+
+// Writes `n` elements, padded to a multiple of 8 bytes.
+template <typename T> bool write_section(FILE *file, const T *data, size_t n) {
+  static const char zeros[8] = {};
+  size_t pad = padding(n * sizeof(T));
+  return (n == 0 || std::fwrite(data, sizeof(T), n, file) == n) &&
+         std::fwrite(zeros, 1, pad, file) == pad;
+}
+
+template <typename T> bool write_section(FILE *file, const std::vector<T> &v) {
+  return write_section(file, v.data(), v.size());
+}
+
+// Hands out the sections of a mapped file in order, or NULL once a section
+// would run past its end.
+struct Reader {
+  const char *data;
+  size_t size, offset;
+
+  template <typename T> const T *section(size_t n) {
+    size_t bytes = n * sizeof(T);
+    if (n > size / sizeof(T) || size - offset < bytes)
+      return NULL;
+    const T *ret = reinterpret_cast<const T *>(data + offset);
+    offset = std::min(size, offset + bytes + padding(bytes));
+    return ret;
+  }
+};
+
+} // namespace
+
+// Writes to a temporary file first and renames it over `path`, so an
+// interrupted save never destroys the previous snapshot.
+bool Snapshot::save(const State &state, const std::string &path) {
+  const Population &p = state.population;
+  size_t n = p.size();
+
+  std::vector<EntityRecord> records(n, EntityRecord{});
+  std::vector<int64_t> parasites;
+  std::string names;
+
+  for (size_t i = 0; i < n; i++)
+    records[i].cell_position = -1;
+  for (int c = 0; c < state.grid.num_cells(); c++) {
+    const std::vector<Entity *> &members = state.grid.cell_value(c);
+    for (size_t k = 0; k < members.size(); k++)
+      records[members[k]->index_value()].cell_position = k;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    const Entity *e = state.entities[i];
+    const Entity *host = e->host_value();
+    const Entity *target = e->current_target_value();
+    EntityRecord &r = records[i];
+
+    r.id = e->id;
+    r.parent_ids[0] = e->parent_ids[0];
+    r.parent_ids[1] = e->parent_ids[1];
+    r.name_hash = e->name_hash_code;
+    r.host = host != NULL ? host->id : -1;
+    r.current_target = target != NULL ? target->id : -1;
+    r.name_offset = names.size();
+    r.name_length = e->name.size();
+    names += e->name;
+    r.parasites_offset = parasites.size();
+    for (auto &handle : e->parasites) {
+      const Entity *parasite = state.entity_value(handle);
+      if (parasite != NULL) {
+        parasites.push_back(parasite->id);
+        r.num_parasites++;
+      }
+    }
+  }
+
+  std::vector<AffinityRecord> affinities;
+  for (int s = 0; s < AffinityStore::num_shards; s++) {
+    for (auto &pair : state.affinities.shard_value(s)) {
+      const Affinity &a = pair.second;
+      affinities.push_back(
+          {pair.first.first, pair.first.second, a.d2, a.value, a.epoch});
+    }
+  }
+
+  const Genealogy &genealogy = state.genealogy;
+  std::vector<LineageRecord> lineages(genealogy.size(), LineageRecord{});
+  for (int k = 0; k < genealogy.size(); k++) {
+    const Lineage &l = genealogy.lineage_value(k);
+    LineageRecord &r = lineages[k];
+    r.parent_ids[0] = genealogy.parent_value(k, 0);
+    r.parent_ids[1] = genealogy.parent_value(k, 1);
+    r.birth = l.birth;
+    r.death = l.death;
+    r.genome = l.genome;
+  }
+
+  Header header = {};
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  header.header_size = sizeof(Header);
+  header.money = state.money;
+  header.x_size = state.x_size;
+  header.y_size = state.y_size;
+  header.epoch = state.epoch;
+  header.next_id = state.next_id;
+  header.seed = state.seed;
+  header.num_entities = n;
+  header.num_parasites = parasites.size();
+  header.num_affinities = affinities.size();
+  header.names_size = names.size();
+  header.num_lineages = lineages.size();
+
+  std::string temporary = path + ".tmp";
+  FILE *file = std::fopen(temporary.c_str(), "wb");
+  if (file == NULL)
+    return false;
+
+  bool ok = write_section(file, &header, 1) && write_section(file, p.x) &&
+            write_section(file, p.y) && write_section(file, p.px) &&
+            write_section(file, p.py) && write_section(file, p.energy) &&
+            write_section(file, p.mood) && write_section(file, p.age) &&
+            write_section(file, p.conception_mass) &&
+            write_section(file, p.epoch_of_death) &&
+            write_section(file, p.flags) && write_section(file, p.genome) &&
+            write_section(file, p.cell) && write_section(file, records) &&
+            write_section(file, parasites) &&
+            write_section(file, affinities) &&
+            write_section(file, names.data(), names.size()) &&
+            write_section(file, lineages);
+  ok = (std::fclose(file) == 0) && ok;
+
+  if (ok)
+    ok = std::rename(temporary.c_str(), path.c_str()) == 0;
+  if (!ok)
+    std::remove(temporary.c_str());
+  return ok;
+}
+
+// Returns the restored world, or NULL if `path` can't be read or isn't a
+// snapshot of this version.
+State *Snapshot::load(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = info.st_size;
+  void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return NULL;
+
+  State *state = restore(static_cast<const char *>(data), size);
+  munmap(data, size);
+  return state;
+}
+
+State *Snapshot::restore(const char *data, size_t size) {
+  Reader in = {data, size, 0};
+
+  const Header *header = in.section<Header>(1);
+  if (header == NULL || std::memcmp(header->magic, magic, sizeof(magic)) ||
+      header->version != version || header->header_size != sizeof(Header) ||
+      header->num_entities < 0 || header->num_parasites < 0 ||
+      header->num_affinities < 0 || header->names_size < 0 ||
+      header->num_lineages != header->next_id)
+    return NULL;
+
+  size_t n = header->num_entities;
+  const double *x = in.section<double>(n);
+  const double *y = in.section<double>(n);
+  const double *px = in.section<double>(n);
+  const double *py = in.section<double>(n);
+  const double *energy = in.section<double>(n);
+  const double *mood = in.section<double>(n);
+  const double *age = in.section<double>(n);
+  const double *conception_mass = in.section<double>(n);
+  const long *epoch_of_death = in.section<long>(n);
+  const unsigned char *flags = in.section<unsigned char>(n);
+  const Genome *genome = in.section<Genome>(n);
+  const int *cell = in.section<int>(n);
+  const EntityRecord *records = in.section<EntityRecord>(n);
+  const int64_t *parasites = in.section<int64_t>(header->num_parasites);
+  const AffinityRecord *affinities =
+      in.section<AffinityRecord>(header->num_affinities);
+  const char *names = in.section<char>(header->names_size);
+  const LineageRecord *lineages =
+      in.section<LineageRecord>(header->num_lineages);
+
+  if (x == NULL || y == NULL || px == NULL || py == NULL || energy == NULL ||
+      mood == NULL || age == NULL || conception_mass == NULL ||
+      epoch_of_death == NULL || flags == NULL || genome == NULL ||
+      cell == NULL || records == NULL || parasites == NULL ||
+      affinities == NULL || names == NULL || lineages == NULL)
+    return NULL;
+
+  State *state = new State(header->money, header->epoch, header->x_size,
+                           header->y_size, header->seed);
+  state->next_id = header->next_id;
+
+  Population &p = state->population;
+  p.x.assign(x, x + n);
+  p.y.assign(y, y + n);
+  p.px.assign(px, px + n);
+  p.py.assign(py, py + n);
+  p.energy.assign(energy, energy + n);
+  p.mood.assign(mood, mood + n);
+  p.age.assign(age, age + n);
+  p.conception_mass.assign(conception_mass, conception_mass + n);
+  p.epoch_of_death.assign(epoch_of_death, epoch_of_death + n);
+  p.flags.assign(flags, flags + n);
+  p.genome.assign(genome, genome + n);
+  p.cell.assign(cell, cell + n);
+  p.derived_mass.resize(n);
+  p.derived_max_energy.resize(n);
+  p.derived_terminal_speed.resize(n);
+  for (size_t i = 0; i < n; i++)
+    p.derive(i);
+
+  // Ids were handed out in increasing order and rows only get reordered by
+  // swap-removal, so this is nearly sorted already.
+  std::vector<std::pair<int64_t, int>> by_id(n);
+  bool ok = true;
+
+  for (size_t i = 0; i < n && ok; i++) {
+    const EntityRecord &r = records[i];
+    // Ids index the genealogy, which holds next_id lineages.
+    ok = r.id >= 0 && r.id < header->next_id && r.name_offset >= 0 &&
+         r.name_length >= 0 &&
+         r.name_offset + r.name_length <= header->names_size;
+    if (!ok)
+      break;
+    long parent_ids[2] = {long(r.parent_ids[0]), long(r.parent_ids[1])};
+    Entity *e = new (state->entity_pool)
+        Entity(state, r.id, parent_ids,
+               std::string(names + r.name_offset, r.name_length), r.name_hash,
+               i);
+    e->handle = state->entities.insert(e);
+    by_id[i] = {r.id, int(i)};
+  }
+  if (!std::is_sorted(by_id.begin(), by_id.end()))
+    std::sort(by_id.begin(), by_id.end());
+  ok = ok && std::adjacent_find(by_id.begin(), by_id.end(),
+                                [](const std::pair<int64_t, int> &a,
+                                   const std::pair<int64_t, int> &b) {
+                                  return a.first == b.first;
+                                }) == by_id.end();
+
+  auto handle_of = [&](int64_t id, Handle &handle) {
+    if (id < 0)
+      return true;
+    auto iter = std::lower_bound(by_id.begin(), by_id.end(),
+                                 std::make_pair(id, 0));
+    if (iter == by_id.end() || iter->first != id)
+      return false;
+    handle = state->entities[iter->second]->handle;
+    return true;
+  };
+
+  for (size_t i = 0; i < n && ok; i++) {
+    const EntityRecord &r = records[i];
+    Entity *e = state->entities[i];
+    ok = handle_of(r.host, e->host) &&
+         handle_of(r.current_target, e->current_target) &&
+         r.parasites_offset >= 0 && r.num_parasites >= 0 &&
+         r.parasites_offset + r.num_parasites <= header->num_parasites;
+    for (int k = 0; k < r.num_parasites && ok; k++) {
+      Handle handle;
+      ok = handle_of(parasites[r.parasites_offset + k], handle);
+      e->parasites.push_back(handle);
+    }
+  }
+
+  for (size_t i = 0; i < n && ok; i++) {
+    Entity *e = state->entities[i];
+    Entity *target = state->entity_value(e->current_target);
+    if (target != NULL)
+      target->pursuers.push_back(e->handle);
+  }
+
+  // Restoring each cell's saved order keeps the order pairs are visited in,
+  // and with it the order their outcomes are committed in.
+  int num_cells = state->grid.num_cells();
+  std::vector<int> cell_size(num_cells, 0);
+  for (size_t i = 0; i < n && ok; i++) {
+    ok = cell[i] < num_cells &&
+         (cell[i] < 0 || state->grid.cell_index(x[i], y[i]) == cell[i]);
+    if (ok && cell[i] >= 0)
+      cell_size[cell[i]]++;
+  }
+  for (int c = 0; c < num_cells && ok; c++) {
+    if (cell_size[c] > 0)
+      state->grid.resize_cell(c, cell_size[c]);
+  }
+  for (size_t i = 0; i < n && ok; i++) {
+    if (cell[i] < 0)
+      continue;
+    int position = records[i].cell_position;
+    ok = position >= 0 && position < cell_size[cell[i]] &&
+         state->grid.cell_value(cell[i])[position] == NULL;
+    if (ok)
+      state->grid.place(state->entities[i], cell[i], position);
+  }
+
+  for (int64_t k = 0; k < header->num_affinities && ok; k++) {
+    const AffinityRecord &a = affinities[k];
+    state->affinities.insert(a.a, a.b, {a.d2, a.value, a.epoch});
+  }
+
+  // Parents always come before their children.
+  for (int64_t k = 0; k < header->num_lineages && ok; k++) {
+    const LineageRecord &l = lineages[k];
+    ok = l.parent_ids[0] < k && l.parent_ids[1] < k;
+    if (ok) {
+      state->genealogy.add(k, l.birth, l.genome, l.parent_ids[0],
+                           l.parent_ids[1]);
+      if (l.death >= 0)
+        state->genealogy.set_death(k, l.death);
+    }
+  }
+
+  if (!ok) {
+    delete state;
+    return NULL;
+  }
+  return state;
+}
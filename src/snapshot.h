@@ -0,0 +1,61 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+
+class State;
+
+// Saves and restores the whole world: the population columns, every entity
+// with its name or parent ids, host, parasites and current target (as ids),
+// the grid's per-cell order, the affinity store, the genealogy, and the
+// clock, money, id counter and seed that together determine every random
+// draw. A restored world continues exactly as the saved one would have.
+//
+// The file is a header followed by 8-byte aligned sections laid out the way
+// they're held in memory, so restoring maps the file and copies each column
+// once.
+class Snapshot {
+
+public:
+  static constexpr char magic[8] = {'T', 'E', 'C', 'H', 'S', 'N', 'A', 'P'};
+  static constexpr uint32_t version = 4;
+
+  struct Header {
+    char magic[8];
+    uint32_t version, header_size;
+    double money, x_size, y_size;
+    int64_t epoch, next_id;
+    uint64_t seed;
+    int64_t num_entities, num_parasites, num_affinities, names_size,
+        num_lineages;
+  };
+
+  struct EntityRecord {
+    int64_t id, parent_ids[2], host, current_target;
+    uint64_t name_hash;
+    int64_t name_offset, parasites_offset;
+    int32_t name_length, num_parasites;
+    int32_t cell_position, padding;
+  };
+
+  struct AffinityRecord {
+    int64_t a, b;
+    double d2, value;
+    int64_t epoch;
+  };
+
+  struct LineageRecord {
+    int64_t parent_ids[2], birth, death;
+    uint32_t genome, padding;
+  };
+
+private:
+  static State *restore(const char *, size_t);
+
+public:
+  static bool save(const State &, const std::string &);
+  static State *load(const std::string &);
+};
+
+#endif
@@ -1,7 +1,9 @@
 #include "entity.h"
+#include "recorder.h"
 #include "state.h"
 #include "utility.h"
 #include <algorithm>
+#include <cassert>
 #include <cmath>
 #include <functional>
 #include <iomanip>
@@ -9,18 +11,22 @@
 #include <sstream>
 
 State::State(double money, long epoch, double x_size, double y_size)
-    : money(money), epoch(epoch), x_size(x_size), y_size(y_size) {
-  std::random_device rd;
-  random_generator = new std::default_random_engine(rd());
+    : State(money, epoch, x_size, y_size, std::random_device()()) {}
+
+State::State(double money, long epoch, double x_size, double y_size,
+             unsigned long seed)
+    : money(money), epoch(epoch), next_id(0), seed(seed), x_size(x_size),
+      y_size(y_size), grid(x_size, y_size, std::sqrt(forget_distance2)),
+      gametophyte_grid(x_size, y_size, gametophyte_range),
+      pool(new ThreadPool(1)), event_log(NULL), recorder(NULL),
+      event_counts() {
   newx_dist = std::uniform_real_distribution<double>(0.0, x_size);
   newy_dist = std::uniform_real_distribution<double>(0.0, y_size);
-  entities = std::vector<Entity *>();
 }
 
 State::~State() {
-  delete (random_generator);
   for (auto i : entities)
-    delete i;
+    entity_pool.destroy(i);
 }
 
 double State::money_value() const { return money; }
@@ -29,6 +35,40 @@ long State::epoch_value() const { return epoch; }
 
 double State::x_size_value() const { return x_size; }
 
+void State::set_event_log(EventLog *log) { event_log = log; }
+
+void State::set_recorder(Recorder *r) { recorder = r; }
+
+// Events of this kind since the world was created or loaded.
+long State::event_count(Event kind) const { return event_counts[int(kind)]; }
+
+// Counts an event involving up to three entities and records it, if a log
+// is attached and wants events of this kind.
+void State::log_event(Event kind, const Entity *a, const Entity *b,
+                      const Entity *c, int value) {
+  event_counts[int(kind)]++;
+  if (event_log == NULL || !event_log->enabled(kind))
+    return;
+
+  EventRecord record = {};
+  record.epoch = epoch;
+  record.kind = kind;
+  record.value = value;
+  const Entity *involved[3] = {a, b, c};
+  for (int k = 0; k < 3; k++) {
+    record.ids[k] = involved[k] != NULL ? involved[k]->id_value() : -1;
+    record.hashes[k] = involved[k] != NULL ? involved[k]->name_hash_value() : 0;
+  }
+  event_log->log(record);
+}
+
+int State::num_threads_value() const { return pool->num_threads(); }
+
+void State::set_num_threads(int num_threads) {
+  if (num_threads != pool->num_threads())
+    pool.reset(new ThreadPool(num_threads));
+}
+
 double State::y_size_value() const { return y_size; }
 
 std::string State::date_str() const {
@@ -41,96 +81,32 @@ void State::update() {
   money -= 0.1;
   epoch += tick_time;
 
-  std::for_each(entities.begin(), entities.end(), std::mem_fn(&Entity::move));
+  steer_entities();
+  move_entities();
 
-  std::for_each(entities.begin(), entities.end(),
-                std::mem_fn(&Entity::adjust_needs));
+  adjust_needs();
 
   int old_num = num_entities();
 
   std::vector<Entity *> offspring;
 
-  for (int i = 0; i < d2s.size(); i++) {
-    for (int j = i + 1; j < d2s[i].size(); j++) {
-      if (!entities[i]->alive_value() || !entities[j]->alive_value())
-        continue;
+  interact_neighbours(offspring);
 
-      if (entities[i]->host_value() != NULL ||
-          entities[j]->host_value() != NULL)
-        continue;
+  mate_gametophytes(offspring);
 
-      d2s[i][j] = pow(entities[i]->x_value() - entities[j]->x_value(), 2) +
-                  pow(entities[i]->y_value() - entities[j]->y_value(), 2);
-      affinities[i][j] +=
-          0.1 * (interaction_distance * interaction_distance - d2s[i][j]);
-      affinities[i][j] = std::max(std::min(affinities[i][j], 1.0), 0.0);
-
-      if (affinities[i][j] > 0.8) {
-        entities[i]->interact(*entities[j]);
-        // std::cout << i << " and " << j << " interacted." << std::endl;
-
-        // Eating.
-        bool ieatj =
-            entities[i]->current_strength() > entities[j]->current_strength();
-        int eater = ieatj ? i : j;
-        int target = ieatj ? j : i;
-
-        if (entities[eater]->is_hungry() &&
-            entities[eater]->will_eat_target(entities[target])) {
-          entities[eater]->consume(*entities[target]);
-          std::cout << entities[eater]->name_hash() << " ate "
-                    << entities[target]->name_hash() << "!" << std::endl;
-          continue;
-        }
-      }
-      if ((entities[i]->gene_value("geodispersal gametophytes/not") &
-           entities[j]->gene_value("geodispersal gametophytes/not")) ||
-          affinities[i][j] > 0.8) {
-        if (entities[i]->will_mate() && entities[j]->will_mate() &&
-            entities[i]->will_mate_target(entities[j])) {
-          // Mating.
-          offspring.push_back(entities[i]->mate(*entities[j]));
-          std::cout << entities[i]->name_hash() << " and "
-                    << entities[j]->name_hash()
-                    << " mated (name: " << offspring.back()->name_hash()
-                    << ")." << std::endl;
-        }
-      }
-    }
-  }
+  // Offspring were registered on construction but join the grid only now,
+  // so that the sweep above never sees them.
+  for (auto &e : offspring)
+    e->enter_grid();
 
-  entities.insert(entities.end(), std::make_move_iterator(offspring.begin()),
-                  std::make_move_iterator(offspring.end()));
+  // Pairs not visited this tick are no longer in neighbouring cells, so at
+  // least a cell width, sqrt(forget_distance2), apart. Their affinity would
+  // drop by 0.1 * (d2 - interaction_distance^2) >= 1, to zero.
+  pool->parallel_for(AffinityStore::num_shards, [&](int shard) {
+    affinities.sweep(shard, epoch, 1.0);
+  });
 
-  resize_pairwise();
-
-  // Determine which entities we are removing.
-  std::vector<int> to_erase;
-  for (int i = 0; i < num_entities(); i++) {
-    if (!entities[i]->alive_value() &&
-        entities[i]->time_since_death() > Entity::corpse_lifetime) {
-      to_erase.push_back(i);
-    }
-  }
-
-  // Erase these entities, and associated array structures.
-  entities.erase(
-      ToggleIndices(entities, std::begin(to_erase), std::end(to_erase)),
-      entities.end());
-
-  for (int i = 0; i < d2s.size(); i++) {
-    d2s[i].erase(
-        ToggleIndices(d2s[i], std::begin(to_erase), std::end(to_erase)),
-        d2s[i].end());
-    affinities[i].erase(
-        ToggleIndices(affinities[i], std::begin(to_erase), std::end(to_erase)),
-        affinities[i].end());
-  }
-  d2s.erase(ToggleIndices(d2s, std::begin(to_erase), std::end(to_erase)),
-            d2s.end());
-  affinities.erase(
-      ToggleIndices(affinities, std::begin(to_erase), std::end(to_erase)),
-      affinities.end());
+  remove_corpses();
 
   // Kill entities marked to die.
   for (auto &e: entities)
@@ -138,72 +114,447 @@ void State::update() {
       e->kill();
 
   // Check if any entities met criteria for death.
-  std::for_each(entities.begin(), entities.end(),
-                std::mem_fn(&Entity::check_for_death));
+  check_for_death();
 
   int new_num = num_entities();
 
   if (new_num != old_num) {
-    std::cout << "Entity count changed to: " << new_num << std::endl
-              << std::flush;
+    log_event(Event::population, NULL, NULL, NULL, new_num);
+  }
+
+  if (recorder != NULL)
+    recorder->record(*this);
+}
+
+void State::remove_corpses() { remove_corpses(Entity::corpse_lifetime); }
+
+// Erases corpses that have been dead for longer than `lifetime`. Handles to
+// them held elsewhere become stale.
+void State::remove_corpses(double lifetime) {
+  std::vector<Entity *> to_erase;
+  for (auto &e : entities) {
+    if (!e->alive_value() && e->time_since_death() > lifetime)
+      to_erase.push_back(e);
+  }
+
+  for (auto &e : to_erase)
+    remove_entity(e);
+  entity_pool.destroy(to_erase);
+}
+
+// Calls `body(i, deferred)` for every population row i, in chunks of
+// chunk_size rows spread over the thread pool. Each chunk gets its own
+// cleared Deferred buffer; returns the number of chunks used.
+template <typename Body> int State::parallel_rows(Body body) {
+  int n = population.size();
+  int num_chunks = (n + chunk_size - 1) / chunk_size;
+  if (int(deferred.size()) < num_chunks)
+    deferred.resize(num_chunks);
+
+  pool->parallel_for(num_chunks, [&](int c) {
+    Deferred &d = deferred[c];
+    d.clear();
+    int end = std::min(n, (c + 1) * chunk_size);
+    for (int i = c * chunk_size; i < end; i++)
+      body(i, d);
+  });
+
+  return num_chunks;
+}
+
+void State::steer_entities() {
+  Population &p = population;
+
+  index_targets();
+
+  int num_chunks =
+      parallel_rows([&](int i, Deferred &d) { entities[i]->move(d); });
+
+  for (int c = 0; c < num_chunks; c++) {
+    for (int i : deferred[c].births)
+      entities[i]->detach_from_host();
+    for (auto &m : deferred[c].motions) {
+      p.px[m.index] = m.px;
+      p.py[m.index] = m.py;
+      p.adjust_energy(m.index, m.energy);
+    }
+    for (auto &t : deferred[c].targets)
+      entities[t.first]->set_current_target(t.second);
   }
 }
 
-double State::smallest_non_negative_or_NaN(double a, double b) const {
-  if (a <= 0.0 || std::isnan(a)) {
-    if (b >= 0.0 && !std::isnan(b))
-      return b;
-    return 0.0;
-  } else {
-    return a;
+// Advances every free, mobile, living entity by its momentum, then carries
+// parasites along with their hosts.
+void State::move_entities() {
+  Population &p = population;
+
+  int num_chunks = parallel_rows([&](int i, Deferred &d) {
+    if ((p.flags[i] & (Population::ALIVE | Population::HOSTED)) !=
+            Population::ALIVE ||
+        p.gene<Trait::stationary>(i))
+      return;
+
+    p.x[i] += p.px[i];
+    if (p.x[i] > x_size) {
+      p.x[i] -= x_size;
+    } else if (p.x[i] < 0) {
+      p.x[i] += x_size;
+    }
+
+    p.y[i] += p.py[i];
+    if (p.y[i] > y_size) {
+      p.y[i] -= y_size;
+    } else if (p.y[i] < 0) {
+      p.y[i] += y_size;
+    }
+
+    if (p.cell[i] >= 0 && grid.cell_index(p.x[i], p.y[i]) != p.cell[i])
+      d.cell_moves.push_back(i);
+  });
+
+  for (int c = 0; c < num_chunks; c++)
+    for (int i : deferred[c].cell_moves)
+      p.cell[i] = grid.move(entities[i], p.cell[i], p.x[i], p.y[i]);
+
+  parallel_rows([&](int i, Deferred &) {
+    if (!(p.flags[i] & Population::HOSTED))
+      return;
+    Entity *host = entities[i]->host_value();
+    if (host == NULL)
+      return;
+    int h = host->index_value();
+    p.x[i] = p.x[h];
+    p.y[i] = p.y[h];
+    p.px[i] = 0.0;
+    p.py[i] = 0.0;
+  });
+}
+
+void State::adjust_needs() {
+  Population &p = population;
+
+  int num_chunks = parallel_rows([&](int i, Deferred &d) {
+    p.age[i] += tick_time;
+    p.derive(i);
+    p.mood[i] *= 0.998;
+
+    double cm = p.current_mass(i);
+    bool hosted = p.flags[i] & Population::HOSTED;
+    double metabolism =
+        hosted ? 0 : cm * (-0.0005 - 0.0005 * p.gene<Trait::natural_defenses>(i));
+    double de = metabolism;
+
+    de += cm * (std::min(p.mood[i] * 0.01, 0.0) +
+                0.0012 * p.gene<Trait::photosynthesizes>(i));
+
+    if (hosted) {
+      Entity *host = entities[i]->host_value();
+      if (host != NULL)
+        d.energy.push_back({host->index_value(), metabolism});
+    }
+
+    p.adjust_energy(i, de);
+  });
+
+  for (int c = 0; c < num_chunks; c++)
+    for (auto &e : deferred[c].energy)
+      p.adjust_energy(e.first, e.second);
+}
+
+void State::check_for_death() {
+  Population &p = population;
+
+  int num_chunks = parallel_rows([&](int i, Deferred &d) {
+    if (!(p.flags[i] & Population::ALIVE))
+      return;
+
+    RandomStream rng = random_stream(entities[i]->id_value(), Site::death);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    if (p.energy[i] <= 0.0) {
+      d.deaths.push_back({i, Deferred::STARVED});
+    } else if (unit(rng) < p.prob_death(i)) {
+      d.deaths.push_back({i, Deferred::NATURAL_CAUSES});
+    }
+  });
+
+  for (int c = 0; c < num_chunks; c++) {
+    for (auto &death : deferred[c].deaths) {
+      Entity *e = entities[death.first];
+      // A host's death may already have taken its parasites with it.
+      if (!e->alive_value())
+        continue;
+      e->kill();
+      log_event(death.second == Deferred::STARVED ? Event::starved
+                                                  : Event::died,
+                e);
+    }
+  }
+}
+
+// Interactions between pairs in neighbouring grid cells, in three steps:
+// pairs are found in parallel over rows, their affinities are updated in
+// parallel over store shards, and the outcomes (eating, mating) are committed
+// serially in the order a serial sweep over rows would have visited them.
+void State::interact_neighbours(std::vector<Entity *> &offspring) {
+  Population &p = population;
+
+  // Only pairs in adjacent grid cells can be within interaction distance.
+  int num_chunks = parallel_rows([&](int i, Deferred &d) {
+    if (p.cell[i] < 0 || (p.flags[i] & (Population::ALIVE |
+                                         Population::HOSTED)) !=
+                             Population::ALIVE)
+      return;
+    long id = entities[i]->id_value();
+    int neighbours[9];
+    int nn = grid.neighbour_cells(p.cell[i], neighbours);
+    for (int n = 0; n < nn; n++) {
+      for (Entity *b : grid.cell_value(neighbours[n])) {
+        int j = b->index_value();
+        if (j <= i || (p.flags[j] & (Population::ALIVE | Population::HOSTED)) !=
+                          Population::ALIVE)
+          continue;
+        d.contacts.push_back({i, j, AffinityStore::shard(id, b->id_value()),
+                              grid.periodic_d2(p.x[i], p.y[i], p.x[j], p.y[j]),
+                              0.0});
+      }
+    }
+  });
+
+  // Group the contacts by shard; each pair appears at most once per tick, so
+  // the order of updates within a shard doesn't matter.
+  std::vector<int> shard_begin(AffinityStore::num_shards + 1, 0);
+  for (int c = 0; c < num_chunks; c++)
+    for (auto &contact : deferred[c].contacts)
+      shard_begin[contact.shard + 1]++;
+  for (int s = 0; s < AffinityStore::num_shards; s++)
+    shard_begin[s + 1] += shard_begin[s];
+
+  std::vector<Deferred::Contact *> by_shard(shard_begin.back());
+  std::vector<int> shard_end(shard_begin.begin(), shard_begin.end() - 1);
+  for (int c = 0; c < num_chunks; c++)
+    for (auto &contact : deferred[c].contacts)
+      by_shard[shard_end[contact.shard]++] = &contact;
+
+  pool->parallel_for(AffinityStore::num_shards, [&](int s) {
+    for (int k = shard_begin[s]; k < shard_begin[s + 1]; k++) {
+      Deferred::Contact &contact = *by_shard[k];
+      contact.affinity = affinities.update(
+          entities[contact.i]->id_value(), entities[contact.j]->id_value(),
+          contact.d2,
+          0.1 * (interaction_distance * interaction_distance - contact.d2),
+          epoch);
+    }
+  });
+
+  for (int c = 0; c < num_chunks; c++)
+    for (auto &contact : deferred[c].contacts)
+      interact_pair(contact, offspring);
+}
+
+// Commits the outcome of a neighbouring pair's interaction. Either entity may
+// have been eaten since the pair was proposed.
+void State::interact_pair(const Deferred::Contact &contact,
+                          std::vector<Entity *> &offspring) {
+  int i = contact.i, j = contact.j;
+  double affinity = contact.affinity;
+
+  // Entities eaten earlier this tick are only marked to die, and still
+  // interact and eat until it ends, as when pairs were handled one by one.
+  if (!entities[i]->alive_value() || !entities[j]->alive_value())
+    return;
+
+  if (affinity > 0.8) {
+    entities[i]->interact(*entities[j]);
+    // std::cout << i << " and " << j << " interacted." << std::endl;
+
+    // Eating.
+    bool ieatj =
+        entities[i]->current_strength() > entities[j]->current_strength();
+    int eater = ieatj ? i : j;
+    int target = ieatj ? j : i;
+
+    if (entities[eater]->is_hungry() &&
+        entities[eater]->will_eat_target(entities[target])) {
+      entities[eater]->consume(*entities[target]);
+      log_event(Event::ate, entities[eater], entities[target]);
+      return;
+    }
+  }
+  if ((entities[i]->gene<Trait::geodispersal_gametophytes>() &
+       entities[j]->gene<Trait::geodispersal_gametophytes>()) ||
+      affinity > 0.8) {
+    mate_pair(i, j, offspring);
+  }
+}
+
+void State::mate_pair(int i, int j, std::vector<Entity *> &offspring,
+                      bool met) {
+  if (entities[i]->will_mate() && entities[j]->will_mate() &&
+      entities[i]->will_mate_target(entities[j], met)) {
+    // Mating.
+    offspring.push_back(entities[i]->mate(*entities[j]));
+    log_event(Event::mated, entities[i], entities[j], offspring.back());
+  }
+}
+
+// Geodispersing gametophytes mate at any distance d, with a chance of
+// 1/d^2 (see Entity::will_mate_target()), so only pairs that are both
+// willing are tried. Those within gametophyte_range are found through a
+// grid of cells that wide. Any further pair would succeed with a chance of
+// 1/gametophyte_range^2 times (gametophyte_range/d)^2, so rather than
+// visiting them all, each gametophyte skips ahead through the later ones
+// by geometrically distributed steps to pick those of the first chance,
+// then draws the second. Either way pairs are tried in the order all pairs
+// would be.
+void State::mate_gametophytes(std::vector<Entity *> &offspring) {
+  const double range2 = gametophyte_range * gametophyte_range;
+
+  gametophyte_grid.clear();
+  std::vector<int> gametophytes;
+  for (int i = 0; i < num_entities(); i++) {
+    Entity *e = entities[i];
+    if (e->cell_value() >= 0 &&
+        e->gene<Trait::geodispersal_gametophytes>() && e->will_mate()) {
+      gametophytes.push_back(i);
+      gametophyte_grid.insert(e, e->x_value(), e->y_value());
+    }
+  }
+
+  std::geometric_distribution<int> skip(1.0 / range2);
+  std::uniform_real_distribution<double> u(0.0, 1.0);
+  // Partner rows, and whether the pair has already drawn its chance of
+  // meeting at that distance.
+  std::vector<std::pair<int, bool>> partners;
+  int cells[9];
+  for (int gi = 0; gi < int(gametophytes.size()); gi++) {
+    int i = gametophytes[gi];
+    const Entity *e = entities[i];
+    partners.clear();
+
+    int num_cells = gametophyte_grid.neighbour_cells(
+        gametophyte_grid.cell_index(e->x_value(), e->y_value()), cells);
+    for (int c = 0; c < num_cells; c++) {
+      for (const Entity *other : gametophyte_grid.cell_value(cells[c])) {
+        int j = other->index_value();
+        // Mating distance doesn't wrap round the world.
+        double dx = other->x_value() - e->x_value();
+        double dy = other->y_value() - e->y_value();
+        // Neighbouring pairs were already handled by interact_neighbours().
+        if (j > i && dx * dx + dy * dy <= range2 &&
+            !grid.are_neighbours(e->cell_value(), other->cell_value()))
+          partners.push_back({j, false});
+      }
+    }
+
+    RandomStream rng = random_stream(e->id_value(), Site::gametophytes);
+    for (int gj = gi + 1 + skip(rng); gj < int(gametophytes.size());
+         gj += 1 + skip(rng)) {
+      int j = gametophytes[gj];
+      const Entity *other = entities[j];
+      double dx = other->x_value() - e->x_value();
+      double dy = other->y_value() - e->y_value();
+      double d2 = dx * dx + dy * dy;
+      if (d2 > range2 && u(rng) < range2 / d2 &&
+          !grid.are_neighbours(e->cell_value(), other->cell_value()))
+        partners.push_back({j, true});
+    }
+
+    std::sort(partners.begin(), partners.end());
+    for (auto &partner : partners)
+      mate_pair(i, partner.first, offspring, partner.second);
   }
 }
 
 void State::add_entity(const std::string &name, double x, double y,
                        double conception_mass) {
+  // Keyed by the id the new entity is about to receive.
+  RandomStream rng = random_stream(next_id, Site::spawn);
   if (x == 0.0)
-    x = newx_dist(*random_generator);
+    x = newx_dist(rng);
   if (y == 0.0)
-    y = newy_dist(*random_generator);
-  entities.emplace_back(new Entity(this, name, x, y, conception_mass));
+    y = newy_dist(rng);
+  Entity *entity = new (entity_pool) Entity(this, name, x, y, conception_mass);
+  entity->enter_grid();
+}
+
+long State::new_entity_id() { return next_id++; }
 
-  resize_pairwise();
+unsigned long State::seed_value() const { return seed; }
+
+// Draws for `entity` at `site` in the current tick; see RandomStream.
+RandomStream State::random_stream(long entity, Site site, long other) const {
+  return RandomStream(seed, entity, epoch, site, other);
 }
 
-void State::resize_pairwise() {
-  // Resize pairwise arrays.
-  // std::cout << "Resizing pairwise to " << entities.size() << "." <<
-  // std::endl;
-  d2s.resize(entities.size());
-  affinities.resize(entities.size());
-  for (int i = 0; i < entities.size(); i++) {
-    d2s[i].resize(entities.size());
-    affinities[i].resize(entities.size());
-  }
+Grid *State::get_grid() { return &grid; }
+
+Population *State::get_population() { return &population; }
+
+const Population &State::population_value() const { return population; }
+
+EntityPool *State::get_entity_pool() { return &entity_pool; }
+
+const EntityPool &State::entity_pool_value() const { return entity_pool; }
+
+Genealogy *State::get_genealogy() { return &genealogy; }
+
+const Genealogy &State::genealogy_value() const { return genealogy; }
+
+const int State::num_entities() const { return entities.size(); }
+
+const std::vector<Entity *> &State::entities_value() const {
+  return entities.dense_value();
 }
 
-std::default_random_engine *State::get_random_generator() const {
-  return random_generator;
+// Gives a newly constructed entity its handle and a zeroed population row.
+Handle State::register_entity(Entity *entity) {
+  entity->set_index(population.push_back());
+  return entities.insert(entity);
 }
 
-const int State::num_entities() const { return entities.size(); }
+// Erasing swaps the last row into the hole, in both the slot map and the
+// population, so the entity that moved needs to learn its new index. The
+// caller returns the entity to the pool.
+void State::remove_entity(Entity *entity) {
+  entity->set_current_target(NULL);
+  entity->drop_pursuers();
+
+  int index = entity->index_value();
+  entities.erase(entity->handle_value());
+  population.swap_remove(index);
+  if (index < entities.size())
+    entities[index]->set_index(index);
+}
 
-const std::vector<Entity *> State::entities_value() const { return entities; }
+// Returns NULL for handles to entities that have since been erased.
+Entity *State::entity_value(Handle handle) const {
+  return entities.get(handle);
+}
 
-const std::vector<std::vector<double>> *State::d2s_value() const {
-  return &d2s;
+// Squared distance of a pair from the last tick it was within range, or NaN
+// if the pair isn't currently held.
+double State::d2s_value(const Entity *a, const Entity *b) const {
+  const Affinity *pair = affinities.find(a->id_value(), b->id_value());
+  return pair ? pair->d2 : std::numeric_limits<double>::quiet_NaN();
 }
 
+double State::affinity_value(const Entity *a, const Entity *b) const {
+  const Affinity *pair = affinities.find(a->id_value(), b->id_value());
+  return pair ? pair->value : 0.0;
+}
+
+int State::num_affinities() const { return affinities.size(); }
+
 void State::minimum_vector(const Entity *a, const Entity *b, double &dx,
                            double &dy) const {
   dx = a->x_value() - b->x_value();
   dy = a->y_value() - b->y_value();
 
-  if (abs(dx) > x_size - abs(dx))
-    dx = x_size - abs(dx);
+  if (std::abs(dx) > x_size - std::abs(dx))
+    dx = x_size - std::abs(dx);
 
-  if (abs(dy) > y_size - abs(dy))
-    dy = y_size - abs(dy);
+  if (std::abs(dy) > y_size - std::abs(dy))
+    dy = y_size - std::abs(dy);
 }
 
 void State::intecept_trajectory(const Entity *actor, const Entity *target,
@@ -229,9 +580,6 @@ void State::intecept_trajectory(const Entity *actor, const Entity *target,
 
 double State::entity_intercept_time(const Entity *actor,
                                     const Entity *target) const {
-  // Compute intersection.
-  double a, b, c, t1, t2, st, dx, dy, Phx, Phy;
-  double sh = actor->terminal_speed();
   double Ptx = target->x_value();
   double Pty = target->y_value();
   double Vtx = target->px_value();
@@ -243,66 +591,80 @@ double State::entity_intercept_time(const Entity *actor,
     assert(false);
   }
 
-  // Adjust based on periodic boundaries.
-  minimum_vector(actor, target, dx, dy);
-  Phx = dx + Ptx;
-  Phy = dy + Pty;
-
-  st = std::sqrt(Vtx * Vtx + Vty * Vty);
-
-  a = (Vtx * Vtx) + (Vty * Vty) - (sh * sh);
-  b = 2 * ((Ptx * Vtx) + (Pty * Vty) - (Phx * Vtx) - (Phy * Vty));
-  c = (Ptx * Ptx) + (Pty * Pty) + (Phx * Phx) + (Phy * Phy) - (2 * Phx * Ptx) -
-      (2 * Phy * Pty);
+  return intercept_time(pursuer(actor), Ptx, Pty, Vtx, Vty);
+}
 
-  t1 = (-b + sqrt((b * b) - (4 * a * c))) / (2 * a);
-  t2 = (-b - sqrt((b * b) - (4 * a * c))) / (2 * a);
+Pursuer State::pursuer(const Entity *actor) const {
+  return {actor->x_value(), actor->y_value(), actor->terminal_speed(), x_size,
+          y_size};
+}
 
-  return smallest_non_negative_or_NaN(t1, t2);
+// Indexes where everyone is for this tick's target searches. Called before
+// steering; needs calling again before searching once anything has moved.
+void State::index_targets() {
+  targets.build(entities_value(), x_size, y_size, epoch);
 }
 
+// The entity `actor` could intercept soonest among those it would eat (or
+// mate with), anywhere in the world; only free, living entities qualify.
 const Entity *State::nearest_target(Entity *actor, double &time_of_travel,
                                     std::string looking_for) const {
-  time_of_travel = std::numeric_limits<double>::infinity();
-  const Entity *target = NULL;
-  double t;
-
-  for (int i = 0; i < d2s.size(); i++) {
-    if (entities[i] != actor)
-      continue;
-    for (int j = i + 1; j < d2s[i].size(); j++) {
-      if (entities[j] == actor)
-        continue;
-      if (entities[j]->host_value() != NULL)
-        continue;
-
-      if (looking_for == "mate") {
-        if (!actor->will_mate_target(entities[j]))
-          continue;
-      } else {
-        if (!actor->will_eat_target(entities[j]))
-          continue;
-      }
-
-      t = entity_intercept_time(actor, entities[j]);
-
-      if (t > 0.0 && t < time_of_travel) {
-        time_of_travel = t;
-        target = entities[j];
-      }
-    }
+  assert(targets.is_current(num_entities(), epoch));
+  bool mate = looking_for == "mate";
+
+  // Mates must be close kin, food anything but.
+  TargetIndex::Seeker seeker = {actor->x_value(),
+                                actor->y_value(),
+                                actor->terminal_speed(),
+                                std::numeric_limits<double>::infinity(),
+                                0.0,
+                                actor->genome_value(),
+                                0,
+                                int(Entity::mating_distance)};
+  if (!mate) {
+    seeker.strength = actor->current_strength();
+    seeker.energy = actor->eating_energy();
+    seeker.min_distance = actor->min_eat_distance();
+    seeker.max_distance = 8 * sizeof(Genome);
   }
 
-  return target;
+  int row = targets.nearest(
+      mate ? TargetIndex::MATE : TargetIndex::FOOD, seeker,
+      [&](int j, double time) {
+        const Entity *target = entities[j];
+#ifdef CHECK_INTERCEPT
+        assert(target == actor || time == entity_intercept_time(actor, target));
+#endif
+        (void)time;
+        return target != actor && (mate ? actor->will_mate_target(target)
+                                        : actor->will_eat_target(target));
+      },
+      time_of_travel);
+
+  return row >= 0 ? entities[row] : NULL;
 }
 
-void State::clear_target_from_entities(Entity *entity) {
-  for (auto &e: entities) {
-    const Entity *current_target = e->current_target_value();
-    if (current_target != NULL && entity == current_target) {
-      e->clear_current_target();
+// Answers a batch of searches at once, spread over the thread pool. Actors
+// are taken in grid order so that neighbouring searches share cells.
+void State::nearest_targets(const std::vector<Entity *> &actors,
+                            const std::string &looking_for,
+                            std::vector<const Entity *> &found,
+                            std::vector<double> &times) const {
+  int n = actors.size();
+  std::vector<std::pair<int, int>> order(n);
+  for (int k = 0; k < n; k++)
+    order[k] = {grid.cell_index(actors[k]->x_value(), actors[k]->y_value()), k};
+  std::sort(order.begin(), order.end());
+
+  found.assign(n, NULL);
+  times.assign(n, std::numeric_limits<double>::infinity());
+  pool->parallel_for((n + chunk_size - 1) / chunk_size, [&](int c) {
+    int end = std::min(n, (c + 1) * chunk_size);
+    for (int k = c * chunk_size; k < end; k++) {
+      int a = order[k].second;
+      found[a] = nearest_target(actors[a], times[a], looking_for);
     }
-  }
+  });
 }
 
 int State::trait_index(std::string trait) {
@@ -313,9 +675,7 @@ int State::trait_index(std::string trait) {
 }
 
 int State::entity_index(const Entity *entity) const {
-  for (int i = 0; i < entities.size(); i++) {
-    if (entities[i] == entity)
-      return i;
-  }
-  assert(false);
+  assert(entities.dense_index(entity->handle_value()) ==
+         entity->index_value());
+  return entity->index_value();
 }
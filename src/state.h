@@ -1,50 +1,125 @@
 #ifndef STATE_H
 #define STATE_H
 
+#include "affinity.h"
+#include "deferred.h"
+#include "entity_pool.h"
+#include "event_log.h"
+#include "genealogy.h"
+#include "grid.h"
+#include "intercept.h"
+#include "population.h"
+#include "random.h"
+#include "slot_map.h"
+#include "target_index.h"
+#include "thread_pool.h"
 #include <iostream>
 #include <list>
+#include <memory>
 #include <random>
+#include <string>
+#include <vector>
 
 class Entity;
+class Recorder;
 class State {
 
 private:
   double money;
-  long epoch;
+  long epoch, next_id;
+  unsigned long seed;
   double x_size, y_size;
-  std::vector<Entity *> entities;
-  std::default_random_engine *random_generator;
-  std::vector<std::vector<double>> d2s, affinities;
+  EntityPool entity_pool;
+  SlotMap<Entity *> entities;
+  Population population;
+  Grid grid, gametophyte_grid;
+  AffinityStore affinities;
+  Genealogy genealogy;
+  TargetIndex targets;
+  std::unique_ptr<ThreadPool> pool;
+  std::vector<Deferred> deferred;
+  EventLog *event_log;
+  Recorder *recorder;
+  long event_counts[int(Event::count)];
   std::uniform_real_distribution<double> newx_dist, newy_dist;
 
+  template <typename Body> int parallel_rows(Body);
+  void steer_entities();
+  void move_entities();
+  void adjust_needs();
+  void check_for_death();
+  void interact_neighbours(std::vector<Entity *> &);
+  void interact_pair(const Deferred::Contact &, std::vector<Entity *> &);
+  void mate_pair(int, int, std::vector<Entity *> &, bool = false);
+  void mate_gametophytes(std::vector<Entity *> &);
+  void remove_entity(Entity *);
+
+  friend class Snapshot;
+
 public:
   static constexpr double tick_time = 86400;
   static constexpr double interaction_distance = 5.0;
+  // Pairs at least this far apart (squared) lose at least 1 affinity a
+  // tick, which is all the affinity there is, so the grid's cells are made
+  // this wide and pairs outside neighbouring cells need no distance.
+  static constexpr double forget_distance2 =
+      interaction_distance * interaction_distance + 10.0;
+  // Geodispersing gametophytes this close are tried pair by pair; pairs
+  // further apart are sampled, see mate_gametophytes().
+  static constexpr double gametophyte_range = 100.0;
+  // Rows per chunk of a parallel phase. Fixed, rather than derived from the
+  // thread count, so that the order deferred effects are applied in is too.
+  static constexpr int chunk_size = 256;
 
   State(double, long, double, double);
+  State(double, long, double, double, unsigned long);
   ~State();
   double money_value() const;
   long epoch_value() const;
   std::string date_str() const;
-  std::default_random_engine * get_random_generator() const;
+  unsigned long seed_value() const;
+  int num_threads_value() const;
+  void set_num_threads(int);
+  void set_event_log(EventLog *);
+  void set_recorder(Recorder *);
+  long event_count(Event) const;
+  void log_event(Event, const Entity * = NULL, const Entity * = NULL,
+                 const Entity * = NULL, int = 0);
+  RandomStream random_stream(long, Site, long = -1) const;
+  Grid *get_grid();
+  Population *get_population();
+  const Population &population_value() const;
+  EntityPool *get_entity_pool();
+  const EntityPool &entity_pool_value() const;
+  Genealogy *get_genealogy();
+  const Genealogy &genealogy_value() const;
   void update();
-  double smallest_non_negative_or_NaN(double, double) const;
+  void remove_corpses();
+  void remove_corpses(double);
   void add_entity(const std::string &, double = 0.0, double = 0.0,
                   double = 1.0);
-  void resize_pairwise();
+  long new_entity_id();
   double x_size_value() const;
   double y_size_value() const;
   const int num_entities() const;
-  const std::vector<Entity *> entities_value() const;
-  const std::vector<std::vector<double>> *d2s_value() const;
+  const std::vector<Entity *> &entities_value() const;
+  Handle register_entity(Entity *);
+  Entity *entity_value(Handle) const;
+  double d2s_value(const Entity *, const Entity *) const;
+  double affinity_value(const Entity *, const Entity *) const;
+  int num_affinities() const;
   void minimum_vector(const Entity *, const Entity *, double &,
                       double &) const;
   void intecept_trajectory(const Entity *, const Entity *, double, double &,
                            double &) const;
   double entity_intercept_time(const Entity *, const Entity *) const;
+  Pursuer pursuer(const Entity *) const;
+  void index_targets();
   const Entity *nearest_target(Entity *, double &, std::string) const;
-  void clear_target_from_entities(Entity *);
-  int trait_index(std::string);
+  void nearest_targets(const std::vector<Entity *> &, const std::string &,
+                       std::vector<const Entity *> &,
+                       std::vector<double> &) const;
+  static int trait_index(std::string);
   int entity_index(const Entity *entity) const;
 };
 
@@ -0,0 +1,239 @@
+#include "entity.h"
+#include "target_index.h"
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Bounds are compared against intercept times computed in a different
+// order, so give them a little room for rounding.
+constexpr double slack = 1.0 - 1e-9;
+
+// Targets per bin, on average, when they're spread evenly.
+constexpr double bin_occupancy = 2.0;
+
+int popcount(Genome g) { return std::bitset<32>(g).count(); }
+
+// Whether some genome with all the bits of `all` and none outside `any`
+// might be between min_distance and max_distance bits from the seeker's.
+bool may_match(const TargetIndex::Seeker &s, Genome all, Genome any) {
+  // Bits every genome agrees on differ from the seeker's for sure; the
+  // others might.
+  Genome varies = all ^ any;
+  int differ = popcount((s.genome ^ all) & ~varies);
+  return differ <= s.max_distance &&
+         differ + popcount(varies) >= s.min_distance;
+}
+
+// Offspring of stationary entities can be placed past the edge of the world
+// and stay there, so positions are taken modulo its size.
+double wrap(double v, double size) { return v - size * std::floor(v / size); }
+
+} // namespace
+
+TargetIndex::TargetIndex()
+    : nx(1), ny(1), bin_width(0.0), bin_height(0.0), x_size(0.0), y_size(0.0),
+      epoch(-1), num_rows(-1) {}
+
+// Takes the positions and speeds of every free, living entity as they are
+// now; the index goes stale as soon as anyone moves, joins or leaves.
+void TargetIndex::build(const std::vector<Entity *> &entities, double width,
+                        double height, long now) {
+  x_size = width;
+  y_size = height;
+  epoch = now;
+  num_rows = entities.size();
+
+  std::vector<Entry> found[num_kinds];
+  for (int i = 0; i < num_rows; i++) {
+    const Entity *e = entities[i];
+    if (e->cell_value() < 0 || e->energy_value() <= 0)
+      continue;
+    double px = e->px_value(), py = e->py_value();
+    Entry entry = {wrap(e->x_value(), x_size),
+                   wrap(e->y_value(), y_size),
+                   e->x_value(),
+                   e->y_value(),
+                   px,
+                   py,
+                   std::sqrt(px * px + py * py),
+                   e->current_strength(),
+                   e->energy_value() + e->kill_energy(),
+                   e->genome_value(),
+                   i};
+    found[FOOD].push_back(entry);
+    if (e->energy_value() >= e->mate_energy()) {
+      entry.strength = 0.0;
+      entry.energy = 0.0;
+      found[MATE].push_back(entry);
+    }
+  }
+
+  double side = std::sqrt(x_size * y_size * bin_occupancy /
+                          std::max<size_t>(found[FOOD].size(), 1));
+  nx = std::max(1, std::min(int(x_size / side), 1 << 12));
+  ny = std::max(1, std::min(int(y_size / side), 1 << 12));
+  bin_width = x_size / nx;
+  bin_height = y_size / ny;
+
+  for (int k = 0; k < num_kinds; k++) {
+    Bins &b = bins[k];
+    b.start.assign(nx * ny + 1, 0);
+    b.speed.assign(nx * ny, 0.0);
+    b.strength.assign(nx * ny, std::numeric_limits<double>::infinity());
+    b.energy.assign(nx * ny, 0.0);
+    b.genome_and.assign(nx * ny, ~Genome(0));
+    b.genome_or.assign(nx * ny, 0);
+    b.max_speed = 0.0;
+    b.min_strength = std::numeric_limits<double>::infinity();
+    b.max_energy = 0.0;
+    b.all_genome_and = ~Genome(0);
+    b.all_genome_or = 0;
+
+    // Counting sort by bin, keeping row order within each bin.
+    std::vector<int> bin_of(found[k].size());
+    for (size_t j = 0; j < found[k].size(); j++) {
+      const Entry &e = found[k][j];
+      int ix = std::min(int(e.x / bin_width), nx - 1);
+      int iy = std::min(int(e.y / bin_height), ny - 1);
+      int c = bin_of[j] = iy * nx + ix;
+      b.start[c + 1]++;
+      b.speed[c] = std::max(b.speed[c], e.speed);
+      b.strength[c] = std::min(b.strength[c], e.strength);
+      b.energy[c] = std::max(b.energy[c], e.energy);
+      b.genome_and[c] &= e.genome;
+      b.genome_or[c] |= e.genome;
+      b.max_speed = std::max(b.max_speed, e.speed);
+      b.min_strength = std::min(b.min_strength, e.strength);
+      b.max_energy = std::max(b.max_energy, e.energy);
+      b.all_genome_and &= e.genome;
+      b.all_genome_or |= e.genome;
+    }
+    for (int c = 0; c < nx * ny; c++)
+      b.start[c + 1] += b.start[c];
+
+    std::vector<int> next(b.start.begin(), b.start.end() - 1);
+    b.entries.resize(found[k].size());
+    for (size_t j = 0; j < found[k].size(); j++)
+      b.entries[next[bin_of[j]]++] = found[k][j];
+  }
+}
+
+bool TargetIndex::is_current(int rows, long now) const {
+  return epoch == now && num_rows == rows;
+}
+
+// The distance from a to the interval [lo, hi] or its nearest periodic
+// image.
+double TargetIndex::gap(double a, double lo, double hi, double size) const {
+  double ret = std::numeric_limits<double>::infinity();
+  for (double shift : {-size, 0.0, size})
+    ret = std::min(ret, std::max({0.0, lo + shift - a, a - hi - shift}));
+  return ret;
+}
+
+// Returns the row of the target of this kind that passes the seeker's tests
+// and that the seeker reaches soonest, or -1; `time` is set to the best time
+// found. Ties go to the lowest row, so the answer doesn't depend on the
+// order bins are visited in.
+//
+// Targets that pass the cheap tests are gathered and their intercept times
+// solved batch_size at a time; `accept(row, time)` is then asked only about
+// those that would beat the best so far, and says whether the seeker would
+// take them after all.
+int TargetIndex::nearest(Kind kind, const Seeker &s,
+                         const std::function<bool(int, double)> &accept,
+                         double &time) const {
+  const Bins &b = bins[kind];
+  time = std::numeric_limits<double>::infinity();
+  int best = -1;
+  if (b.entries.empty() || b.min_strength > s.strength ||
+      b.max_energy < s.energy ||
+      !may_match(s, b.all_genome_and, b.all_genome_or))
+    return best;
+
+  double x = wrap(s.x, x_size), y = wrap(s.y, y_size);
+  int cx = std::min(int(x / bin_width), nx - 1);
+  int cy = std::min(int(y / bin_height), ny - 1);
+
+  Pursuer pursuer = {s.x, s.y, s.speed, x_size, y_size};
+  double tx[batch_size], ty[batch_size], vx[batch_size], vy[batch_size];
+  double times[batch_size];
+  int rows[batch_size];
+  int n = 0;
+
+  auto solve = [&] {
+    intercept_times(pursuer, n, tx, ty, vx, vy, times);
+    for (int k = 0; k < n; k++) {
+      double t = times[k];
+      if (t > 0.0 && (t < time || (t == time && rows[k] < best)) &&
+          accept(rows[k], t)) {
+        time = t;
+        best = rows[k];
+      }
+    }
+    n = 0;
+  };
+
+  auto visit = [&](int ix, int iy) {
+    int c = ((iy + ny) % ny) * nx + (ix + nx) % nx;
+    if (b.start[c] == b.start[c + 1] || b.strength[c] > s.strength ||
+        b.energy[c] < s.energy ||
+        !may_match(s, b.genome_and[c], b.genome_or[c]))
+      return;
+    double gx = gap(x, ix * bin_width, (ix + 1) * bin_width, x_size);
+    double gy = gap(y, iy * bin_height, (iy + 1) * bin_height, y_size);
+    if (slack * std::sqrt(gx * gx + gy * gy) / (s.speed + b.speed[c]) > time)
+      return;
+
+    for (int k = b.start[c]; k < b.start[c + 1]; k++) {
+      const Entry &e = b.entries[k];
+      int distance = popcount(s.genome ^ e.genome);
+      if (e.strength > s.strength || e.energy < s.energy ||
+          distance < s.min_distance || distance > s.max_distance)
+        continue;
+      double dx = std::abs(x - e.x), dy = std::abs(y - e.y);
+      dx = std::min(dx, x_size - dx);
+      dy = std::min(dy, y_size - dy);
+      if (slack * std::sqrt(dx * dx + dy * dy) / (s.speed + e.speed) > time)
+        continue;
+
+      tx[n] = e.tx;
+      ty[n] = e.ty;
+      vx[n] = e.vx;
+      vy[n] = e.vy;
+      rows[n] = e.row;
+      if (++n == batch_size)
+        solve();
+    }
+  };
+
+  // Column and row offsets run from -lo to hi so that, on a periodic grid,
+  // every bin is visited exactly once and at its nearest image.
+  int lo_x = (nx - 1) / 2, hi_x = nx / 2;
+  int lo_y = (ny - 1) / 2, hi_y = ny / 2;
+  double step = std::min(bin_width, bin_height);
+
+  for (int r = 0; r <= std::max(hi_x, hi_y); r++) {
+    solve();
+    // Every bin of ring r is at least r - 1 bins from the seeker.
+    if (r > 1 && slack * (r - 1) * step / (s.speed + b.max_speed) > time)
+      break;
+    for (int dy = -std::min(r, lo_y); dy <= std::min(r, hi_y); dy++) {
+      if (std::abs(dy) == r) {
+        for (int dx = -std::min(r, lo_x); dx <= std::min(r, hi_x); dx++)
+          visit(cx + dx, cy + dy);
+      } else {
+        if (r <= lo_x)
+          visit(cx - r, cy + dy);
+        if (r <= hi_x)
+          visit(cx + r, cy + dy);
+      }
+    }
+  }
+  solve();
+
+  return best;
+}
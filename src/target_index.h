@@ -0,0 +1,77 @@
+#ifndef TARGET_INDEX_H
+#define TARGET_INDEX_H
+
+#include "intercept.h"
+#include "traits.h"
+#include <functional>
+#include <vector>
+
+class Entity;
+
+// A copy of where every possible target is and how fast it moves, taken
+// once per tick and binned by position, for finding the target an entity
+// can reach soonest without trying every other entity.
+//
+// An entity moving at speed s can't reach a target at distance d moving at
+// speed v in less than d / (s + v), so the search visits rings of bins
+// around the seeker, nearest first, and stops once even that bound is worse
+// than the best time found. Bins are sized to the number of targets rather
+// than to the interaction grid, so sparse worlds don't mean many empty bins.
+class TargetIndex {
+
+public:
+  // Food is any free living entity with energy left; mates are those with
+  // the energy to mate.
+  enum Kind { FOOD, MATE, num_kinds };
+
+  // Who is searching, and the cheap tests a target must pass before it's
+  // worth asking the seeker: no stronger than `strength`, worth at least
+  // `energy` (its own plus what killing it yields), with a genome between
+  // min_distance and max_distance bits away from `genome`.
+  struct Seeker {
+    double x, y, speed, strength, energy;
+    Genome genome;
+    int min_distance, max_distance;
+  };
+
+private:
+  // Candidates whose intercept times are solved together.
+  static constexpr int batch_size = 64;
+
+  // (x, y) is wrapped into the world, for binning; (tx, ty) is where the
+  // entity really is, and (vx, vy) its velocity, for solving.
+  struct Entry {
+    double x, y, tx, ty, vx, vy, speed, strength, energy;
+    Genome genome;
+    int row;
+  };
+
+  // Per bin, the fastest speed, the weakest strength, the most energy, and
+  // the bits set in every genome and in any genome; and the same over all
+  // bins, so that a seeker no target can satisfy needn't visit any.
+  struct Bins {
+    std::vector<int> start;
+    std::vector<Entry> entries;
+    std::vector<double> speed, strength, energy;
+    std::vector<Genome> genome_and, genome_or;
+    double max_speed, min_strength, max_energy;
+    Genome all_genome_and, all_genome_or;
+  };
+
+  int nx, ny;
+  double bin_width, bin_height, x_size, y_size;
+  Bins bins[num_kinds];
+  long epoch;
+  int num_rows;
+
+  double gap(double, double, double, double) const;
+
+public:
+  TargetIndex();
+  void build(const std::vector<Entity *> &, double, double, long);
+  bool is_current(int, long) const;
+  int nearest(Kind, const Seeker &, const std::function<bool(int, double)> &,
+              double &) const;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int num_threads)
+    : queues(std::max(num_threads, 1)), body(NULL), generation(0), running(0),
+      stopping(false) {
+  for (int i = 1; i < int(queues.size()); i++)
+    workers.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  start.notify_all();
+  for (auto &w : workers)
+    w.join();
+}
+
+int ThreadPool::num_threads() const { return queues.size(); }
+
+// Calls `chunk_body(c)` once for every c in [0, num_chunks), spread over the
+// pool, and returns when all calls have finished.
+void ThreadPool::parallel_for(int num_chunks,
+                              const std::function<void(int)> &chunk_body) {
+  int n = queues.size();
+
+  if (n == 1 || num_chunks <= 1) {
+    for (int c = 0; c < num_chunks; c++)
+      chunk_body(c);
+    return;
+  }
+
+  for (int t = 0; t < n; t++) {
+    std::lock_guard<std::mutex> lock(queues[t].mutex);
+    queues[t].begin = long(num_chunks) * t / n;
+    queues[t].end = long(num_chunks) * (t + 1) / n;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    body = &chunk_body;
+    running = n - 1;
+    generation++;
+  }
+  start.notify_all();
+
+  run_chunks(0);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  finish.wait(lock, [this] { return running == 0; });
+  body = NULL;
+}
+
+void ThreadPool::work(int id) {
+  long seen = 0;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      start.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping)
+        return;
+      seen = generation;
+    }
+
+    run_chunks(id);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      running--;
+    }
+    finish.notify_one();
+  }
+}
+
+void ThreadPool::run_chunks(int id) {
+  int c;
+  while (pop(id, c) || steal(id, c))
+    (*body)(c);
+}
+
+bool ThreadPool::pop(int id, int &chunk) {
+  Queue &q = queues[id];
+  std::lock_guard<std::mutex> lock(q.mutex);
+  if (q.begin >= q.end)
+    return false;
+  chunk = q.begin++;
+  return true;
+}
+
+bool ThreadPool::steal(int id, int &chunk) {
+  for (size_t k = 1; k < queues.size(); k++) {
+    Queue &q = queues[(id + k) % queues.size()];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.begin < q.end) {
+      chunk = --q.end;
+      return true;
+    }
+  }
+  return false;
+}
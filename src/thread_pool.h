@@ -0,0 +1,43 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run the chunks of a parallel_for. Each
+// thread starts with a contiguous run of chunks and, once that is exhausted,
+// steals chunks from the far end of the other threads' runs. The calling
+// thread takes part as thread 0.
+class ThreadPool {
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    int begin, end;
+  };
+
+  std::vector<std::thread> workers;
+  std::vector<Queue> queues;
+  std::mutex mutex;
+  std::condition_variable start, finish;
+  const std::function<void(int)> *body;
+  long generation;
+  int running;
+  bool stopping;
+
+  void work(int);
+  void run_chunks(int);
+  bool pop(int, int &);
+  bool steal(int, int &);
+
+public:
+  ThreadPool(int);
+  ~ThreadPool();
+  int num_threads() const;
+  void parallel_for(int, const std::function<void(int)> &);
+};
+
+#endif
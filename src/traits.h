@@ -0,0 +1,40 @@
+#ifndef TRAITS_H
+#define TRAITS_H
+
+// Each trait is one bit of the genome; a set bit selects the first of the
+// two alternatives in its name.
+enum class Trait : int {
+  stationary,
+  asexual,
+  intelligent,
+  eats_intelligent,
+  eats_passive,
+  photosynthesizes,
+  geodispersal_embryos,
+  geodispersal_gametophytes,
+  natural_defenses,
+  gestates,
+  count
+};
+
+// Names in Trait order, for the string-keyed slow path and for tooling.
+constexpr const char *trait_names[] = {
+    "stationary/mobile",        "asexual/sexual",
+    "intelligent/passive",      "eats intelligent/not",
+    "eats passive/not",         "photosynthesizes/not",
+    "geodispersal embryos/not", "geodispersal gametophytes/not",
+    "natural defenses/not",     "gestates/not"};
+
+constexpr int num_traits = int(Trait::count);
+
+static_assert(sizeof(trait_names) / sizeof(trait_names[0]) == num_traits,
+              "every trait needs a name");
+
+typedef unsigned int Genome;
+
+static_assert(num_traits <= 8 * sizeof(Genome),
+              "the genome must have a bit per trait");
+
+constexpr Genome trait_bit(Trait trait) { return Genome(1) << int(trait); }
+
+#endif
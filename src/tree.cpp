@@ -1,9 +1,188 @@
+#include "genealogy.h"
 #include "technology.h"
 #include "tree.h"
+#include <cassert>
+#include <cstddef>
+#include <queue>
 
-template <class Leaf> Node<Leaf>::Node(Leaf data) : data(data) {}
+template <class Leaf>
+Node<Leaf>::Node(Leaf data)
+    : data(data), parents{-1, -1}, first_child(-1), next_sibling{-1, -1},
+      mark(0), reached(0) {}
 
 template <class Leaf> Leaf Node<Leaf>::get_data() { return data; }
 
+template <class Leaf> const Leaf &Node<Leaf>::data_value() const {
+  return data;
+}
+
+template <class Leaf> Leaf &Node<Leaf>::data_value() { return data; }
+
+template <class Leaf> int Node<Leaf>::parent_value(int k) const {
+  return parents[k];
+}
+
+template <class Leaf> Tree<Leaf>::Tree() : count(0), current_mark(0) {}
+
+// Appends a node with the given parents (-1 for none) and returns its index.
+template <class Leaf> int Tree<Leaf>::add(const Leaf &data, int a, int b) {
+  assert(a < count && b < count);
+  if (b == a)
+    b = -1;
+
+  if (count % block_size == 0) {
+    blocks.emplace_back();
+    blocks.back().reserve(block_size);
+  }
+  blocks.back().emplace_back(data);
+
+  int index = count++;
+  Node<Leaf> &node = (*this)[index];
+  node.parents[0] = a;
+  node.parents[1] = b;
+  for (int k = 0; k < 2; k++) {
+    if (node.parents[k] < 0)
+      continue;
+    Node<Leaf> &parent = (*this)[node.parents[k]];
+    node.next_sibling[k] = parent.first_child;
+    parent.first_child = index;
+  }
+  return index;
+}
+
+template <class Leaf> int Tree<Leaf>::size() const { return count; }
+
+template <class Leaf> void Tree<Leaf>::clear() {
+  blocks.clear();
+  count = 0;
+}
+
+template <class Leaf> Node<Leaf> &Tree<Leaf>::operator[](int i) {
+  return blocks[i / block_size][i % block_size];
+}
+
+template <class Leaf> const Node<Leaf> &Tree<Leaf>::operator[](int i) const {
+  return blocks[i / block_size][i % block_size];
+}
+
+template <class Leaf> unsigned Tree<Leaf>::new_mark() const {
+  if (++current_mark == 0) {
+    for (auto &block : blocks)
+      for (auto &node : block)
+        node.mark = 0;
+    current_mark = 1;
+  }
+  return current_mark;
+}
+
+// The child of `parent` listed after `child`.
+template <class Leaf> int Tree<Leaf>::next_child(int parent, int child) const {
+  const Node<Leaf> &node = (*this)[child];
+  return node.next_sibling[node.parents[0] == parent ? 0 : 1];
+}
+
+// Every ancestor of node i, nearest generations first.
+template <class Leaf>
+void Tree<Leaf>::ancestors(int i, std::vector<int> &out) const {
+  unsigned mark = new_mark();
+  out.clear();
+  (*this)[i].mark = mark;
+
+  int from = i;
+  for (std::size_t next = 0;; next++) {
+    for (int p : (*this)[from].parents) {
+      if (p >= 0 && (*this)[p].mark != mark) {
+        (*this)[p].mark = mark;
+        out.push_back(p);
+      }
+    }
+    if (next >= out.size())
+      break;
+    from = out[next];
+  }
+}
+
+// Every descendant of node i, nearest generations first.
+template <class Leaf>
+void Tree<Leaf>::descendants(int i, std::vector<int> &out) const {
+  unsigned mark = new_mark();
+  out.clear();
+
+  int from = i;
+  for (std::size_t next = 0;; next++) {
+    for (int c = (*this)[from].first_child; c >= 0; c = next_child(from, c)) {
+      if ((*this)[c].mark != mark) {
+        (*this)[c].mark = mark;
+        out.push_back(c);
+      }
+    }
+    if (next >= out.size())
+      break;
+    from = out[next];
+  }
+}
+
+// Whether node a is an ancestor of node d. Parents come before their
+// children, so the search never needs to go below index a.
+template <class Leaf> bool Tree<Leaf>::is_ancestor(int a, int d) const {
+  if (a >= d)
+    return false;
+
+  unsigned mark = new_mark();
+  std::vector<int> stack(1, d);
+  while (!stack.empty()) {
+    int i = stack.back();
+    stack.pop_back();
+    for (int p : (*this)[i].parents) {
+      if (p == a)
+        return true;
+      if (p > a && (*this)[p].mark != mark) {
+        (*this)[p].mark = mark;
+        stack.push_back(p);
+      }
+    }
+  }
+  return false;
+}
+
+// The latest-added node that is an ancestor of (or is) both a and b, or -1.
+// Nodes are visited in decreasing index order, so by the time a node is
+// reached everything that could lead to it has been, and the first node
+// found to lead to both is the most recent common ancestor.
+template <class Leaf> int Tree<Leaf>::common_ancestor(int a, int b) const {
+  if (a == b)
+    return a;
+
+  unsigned mark = new_mark();
+  std::priority_queue<int> frontier;
+  (*this)[a].mark = (*this)[b].mark = mark;
+  (*this)[a].reached = 1;
+  (*this)[b].reached = 2;
+  frontier.push(a);
+  frontier.push(b);
+
+  while (!frontier.empty()) {
+    int i = frontier.top();
+    frontier.pop();
+    const Node<Leaf> &node = (*this)[i];
+    if (node.reached == 3)
+      return i;
+    for (int p : node.parents) {
+      if (p < 0)
+        continue;
+      const Node<Leaf> &parent = (*this)[p];
+      if (parent.mark != mark) {
+        parent.mark = mark;
+        parent.reached = 0;
+        frontier.push(p);
+      }
+      parent.reached |= node.reached;
+    }
+  }
+  return -1;
+}
+
 // Instantiate the particular template variants we want.
 template class Node<Technology>;
+template class Node<Lineage>;
+template class Tree<Lineage>;
@@ -1,9 +1,61 @@
+#ifndef TREE_H
+#define TREE_H
+
+#include <vector>
+
+template <class Leaf> class Tree;
+
+// A node of a family tree: a leaf value, up to two parents, and links to its
+// children, all as indices into the Tree that holds it.
 template <class Leaf> class Node {
 
 private:
   Leaf data;
+  int parents[2];
+  int first_child;
+  // The next child of parents[0] and of parents[1] respectively.
+  int next_sibling[2];
+  // Scratch space for queries: which of the query's starting nodes reach
+  // this one, valid while `mark` matches the tree's current mark.
+  mutable unsigned mark;
+  mutable unsigned char reached;
+
+  friend class Tree<Leaf>;
 
 public:
   Node(Leaf data);
   Leaf get_data();
+  const Leaf &data_value() const;
+  Leaf &data_value();
+  int parent_value(int) const;
 };
+
+// An append-only family tree. Nodes live in fixed-size blocks, so adding one
+// never moves the others and costs no allocation of its own; a node's
+// parents always come before it.
+template <class Leaf> class Tree {
+
+private:
+  static constexpr int block_size = 1 << 16;
+
+  std::vector<std::vector<Node<Leaf>>> blocks;
+  int count;
+  mutable unsigned current_mark;
+
+  unsigned new_mark() const;
+  int next_child(int, int) const;
+
+public:
+  Tree();
+  int add(const Leaf &, int = -1, int = -1);
+  int size() const;
+  void clear();
+  Node<Leaf> &operator[](int);
+  const Node<Leaf> &operator[](int) const;
+  void ancestors(int, std::vector<int> &) const;
+  void descendants(int, std::vector<int> &) const;
+  bool is_ancestor(int, int) const;
+  int common_ancestor(int, int) const;
+};
+
+#endif